@@ -0,0 +1,161 @@
+// attendance_client: sends requests to attendanced and prints the replies.
+//
+//   attendance_client [--socket PATH | --tcp PORT] [REQUEST...]
+//
+// With a request on the command line it is sent as one line, e.g.
+//   attendance_client MARK EEE227/2025-09-01/08:00 UG1001=P UG1002=L
+// Without one, requests are read from stdin, one per line, and pipelined:
+// they are written as fast as the daemon accepts them while the replies
+// are read back, so a file of thousands of marks needs no round trip per
+// line. The exit status is 1 if any reply is an error.
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "text_parse.h"
+
+using namespace std;
+
+const string DEFAULT_SOCKET = "attendanced.sock";
+
+int connectUnix(const string& path) {
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(path.size() >= sizeof(address.sun_path)) return -1;
+    memcpy(address.sun_path, path.c_str(), path.size());
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int connectTcp(int port) {
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(int argc, char* argv[]) {
+    string socketPath = DEFAULT_SOCKET;
+    int tcpPort = 0;
+    string request;
+    for(int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if(request.empty() && arg == "--socket" && i + 1 < argc) {
+            socketPath = argv[++i];
+        } else if(request.empty() && arg == "--tcp" && i + 1 < argc) {
+            if(!parseNumber(argv[++i], tcpPort) || tcpPort <= 0 || tcpPort > 65535) {
+                cout << "Usage: " << argv[0] << " [--socket PATH | --tcp PORT] [REQUEST...]\n";
+                return 2;
+            }
+        } else if(request.empty() && (arg == "--help" || arg == "-h")) {
+            cout << "Usage: " << argv[0] << " [--socket PATH | --tcp PORT] [REQUEST...]\n";
+            return 2;
+        } else {
+            request += (request.empty() ? "" : " ") + arg;
+        }
+    }
+    
+    int fd = tcpPort > 0 ? connectTcp(tcpPort) : connectUnix(socketPath);
+    if(fd < 0) {
+        cerr << "✗ Error: Could not connect to attendanced at "
+             << (tcpPort > 0 ? "127.0.0.1:" + to_string(tcpPort) : socketPath) << ": " << strerror(errno) << endl;
+        return 1;
+    }
+    
+    // Requests to send: the command line, or stdin read as it is needed
+    string output = request.empty() ? "" : request + "\n";
+    bool inputDone = !request.empty();
+    size_t sent = 0;
+    size_t requests = request.empty() ? 0 : 1;
+    size_t replies = 0;
+    bool anyError = false;
+    bool writeClosed = false;
+    string input;
+    
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    const size_t HIGH_WATER = 1 << 20;
+    char block[64 * 1024];
+    
+    while(!inputDone || sent < output.size() || replies < requests) {
+        // Top up the send buffer from stdin, counting the lines
+        while(!inputDone && output.size() - sent < HIGH_WATER) {
+            string line;
+            if(!getline(cin, line)) {
+                inputDone = true;
+                break;
+            }
+            if(line.find_first_not_of(" \t\r") == string::npos) continue;
+            output += line;
+            output += '\n';
+            requests++;
+        }
+        if(sent == output.size()) {
+            output.clear();
+            sent = 0;
+            if(!inputDone) continue;
+            if(!writeClosed) shutdown(fd, SHUT_WR);
+            writeClosed = true;
+        }
+        
+        pollfd watch;
+        watch.fd = fd;
+        watch.events = POLLIN | (sent < output.size() ? POLLOUT : 0);
+        if(poll(&watch, 1, -1) < 0) {
+            if(errno == EINTR) continue;
+            break;
+        }
+        if(watch.revents & POLLOUT) {
+            ssize_t n = send(fd, output.data() + sent, output.size() - sent, MSG_NOSIGNAL);
+            if(n > 0) sent += static_cast<size_t>(n);
+            else if(n < 0 && errno != EAGAIN && errno != EINTR) break;
+        }
+        if(watch.revents & (POLLIN | POLLHUP | POLLERR)) {
+            ssize_t n = read(fd, block, sizeof(block));
+            if(n == 0) break;
+            if(n < 0) {
+                if(errno == EAGAIN || errno == EINTR) continue;
+                break;
+            }
+            input.append(block, static_cast<size_t>(n));
+            size_t start = 0;
+            size_t newline;
+            while((newline = input.find('\n', start)) != string::npos) {
+                string_view reply(input.data() + start, newline - start);
+                if(reply.compare(0, 3, "ERR") == 0) anyError = true;
+                cout << reply << '\n';
+                replies++;
+                start = newline + 1;
+            }
+            input.erase(0, start);
+        }
+    }
+    cout.flush();
+    close(fd);
+    
+    if(replies < requests) {
+        cerr << "✗ Error: the daemon closed the connection after " << replies << " of " << requests << " replies\n";
+        return 1;
+    }
+    return anyError ? 1 : 0;
+}
@@ -0,0 +1,4114 @@
+// Attendance core: students, sessions, the session store, the journal,
+// the compactor and reports, with no console prompts. The interactive
+// menu in main4.cpp and the command-line tools are clients of it; other
+// programs embed it through the API at the end of this file.
+//
+// Everything is inline, so this header is the whole library: include it
+// and link nothing else. A -DATTENDANCE_STATS program also expands
+// ATTENDANCE_ALLOCATION_COUNTER() once, in its main file. Status lines
+// (loaded, saved, migrated) still go to cout; a client that wants silence
+// redirects cout's buffer.
+
+#ifndef ATTENDANCE_CORE_H
+#define ATTENDANCE_CORE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <iomanip>
+#include <sstream>
+#include <map>
+#include <deque>
+#include <list>
+#include <tuple>
+#include <memory>
+#include <new>
+#include <filesystem>
+#include <string_view>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <bitset>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <poll.h>
+#include <csignal>
+#include <cstdlib>
+#include <cerrno>
+#include <pthread.h>
+#include "text_parse.h"
+#include "durable_write.h"
+#include "batch_io.h"
+#include "hash_index.h"
+#include "run_bitmap.h"
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define ATTENDANCE_X86_DISPATCH 1
+#endif
+
+using namespace std;
+namespace fs = std::filesystem;
+
+// Enum for attendance status
+enum AttendanceStatus { PRESENT, ABSENT, LATE };
+
+// Runtime statistics: counters and scoped timers on the load, save, mark,
+// report and lookup paths. Built with -DATTENDANCE_STATS; otherwise the
+// STAT_* macros compile to nothing. Each thread counts into its own block
+// with plain (uncontended) adds; a snapshot sums the live blocks plus
+// whatever threads that have exited left behind.
+enum StatCounter {
+    STAT_FILES_READ, STAT_FILES_WRITTEN, STAT_BYTES_READ, STAT_BYTES_WRITTEN,
+    STAT_PARSE_ERRORS, STAT_LOOKUPS, STAT_ALLOCATIONS, STAT_COUNTER_COUNT
+};
+enum StatTimer {
+    TIMER_LOAD, TIMER_SAVE, TIMER_MARK, TIMER_REPORT, TIMER_FAULT_IN, TIMER_MIGRATE, TIMER_COUNT
+};
+
+const char* const STAT_COUNTER_NAMES[STAT_COUNTER_COUNT] = {
+    "files_read", "files_written", "bytes_read", "bytes_written", "parse_errors", "lookups", "allocations"
+};
+const char* const STAT_TIMER_NAMES[TIMER_COUNT] = {
+    "load", "save", "mark", "report", "fault_in", "migrate"
+};
+
+struct StatTotals {
+    uint64_t counters[STAT_COUNTER_COUNT] = {};
+    uint64_t timerCalls[TIMER_COUNT] = {};
+    uint64_t timerNanos[TIMER_COUNT] = {};
+    uint64_t timerMaxNanos[TIMER_COUNT] = {};
+};
+
+#ifdef ATTENDANCE_STATS
+struct StatBlock {
+    atomic<uint64_t> counters[STAT_COUNTER_COUNT];
+    atomic<uint64_t> timerCalls[TIMER_COUNT];
+    atomic<uint64_t> timerNanos[TIMER_COUNT];
+    atomic<uint64_t> timerMaxNanos[TIMER_COUNT];
+    
+    StatBlock();
+    ~StatBlock();
+    
+    // Only the owning thread writes, so a relaxed load and store is
+    // enough and avoids a locked add
+    static void bump(atomic<uint64_t>& value, uint64_t amount) {
+        value.store(value.load(memory_order_relaxed) + amount, memory_order_relaxed);
+    }
+    
+    void addTo(StatTotals& totals) const {
+        for(int i = 0; i < STAT_COUNTER_COUNT; i++) {
+            totals.counters[i] += counters[i].load(memory_order_relaxed);
+        }
+        for(int i = 0; i < TIMER_COUNT; i++) {
+            totals.timerCalls[i] += timerCalls[i].load(memory_order_relaxed);
+            totals.timerNanos[i] += timerNanos[i].load(memory_order_relaxed);
+            totals.timerMaxNanos[i] = max(totals.timerMaxNanos[i], timerMaxNanos[i].load(memory_order_relaxed));
+        }
+    }
+};
+
+// Fixed-size table of live blocks: registering must not allocate, since
+// the allocation counter itself lands here
+const int MAX_STAT_THREADS = 256;
+inline StatBlock* statBlocks[MAX_STAT_THREADS];
+inline StatTotals retiredStats;
+inline mutex statMutex;
+
+inline StatBlock::StatBlock() {
+    for(auto& c : counters) c.store(0, memory_order_relaxed);
+    for(int i = 0; i < TIMER_COUNT; i++) {
+        timerCalls[i].store(0, memory_order_relaxed);
+        timerNanos[i].store(0, memory_order_relaxed);
+        timerMaxNanos[i].store(0, memory_order_relaxed);
+    }
+    lock_guard<mutex> lock(statMutex);
+    for(auto& slot : statBlocks) {
+        if(slot == nullptr) {
+            slot = this;
+            return;
+        }
+    }
+}
+
+inline StatBlock::~StatBlock() {
+    lock_guard<mutex> lock(statMutex);
+    addTo(retiredStats);
+    for(auto& slot : statBlocks) {
+        if(slot == this) slot = nullptr;
+    }
+}
+
+inline StatBlock& localStats() {
+    thread_local StatBlock block;
+    return block;
+}
+
+inline StatTotals statsSnapshot() {
+    lock_guard<mutex> lock(statMutex);
+    StatTotals totals = retiredStats;
+    for(StatBlock* block : statBlocks) {
+        if(block != nullptr) block->addTo(totals);
+    }
+    return totals;
+}
+
+class ScopedStatTimer {
+private:
+    StatTimer timer;
+    chrono::steady_clock::time_point start;
+    
+public:
+    explicit ScopedStatTimer(StatTimer t) : timer(t), start(chrono::steady_clock::now()) {}
+    ~ScopedStatTimer() {
+        uint64_t nanos = static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+        StatBlock& block = localStats();
+        StatBlock::bump(block.timerCalls[timer], 1);
+        StatBlock::bump(block.timerNanos[timer], nanos);
+        if(nanos > block.timerMaxNanos[timer].load(memory_order_relaxed)) {
+            block.timerMaxNanos[timer].store(nanos, memory_order_relaxed);
+        }
+    }
+};
+
+#define STAT_CONCAT_INNER(a, b) a##b
+#define STAT_CONCAT(a, b) STAT_CONCAT_INNER(a, b)
+#define STAT_ADD(counter, amount) StatBlock::bump(localStats().counters[counter], static_cast<uint64_t>(amount))
+#define STAT_SCOPE(timer) ScopedStatTimer STAT_CONCAT(statTimer, __LINE__)(timer)
+
+// Count every heap allocation. Replacement allocation functions may be
+// defined only once per program, and a header included by several
+// translation units cannot define them, so the program's main file
+// expands ATTENDANCE_ALLOCATION_COUNTER() once at file scope. It replaces
+// every form of operator new and delete: plain, array, nothrow, sized and
+// over-aligned, all going through these two.
+inline void* countedAllocate(size_t size, size_t alignment) {
+    STAT_ADD(STAT_ALLOCATIONS, 1);
+    if(size == 0) size = 1;
+    if(alignment <= alignof(max_align_t)) return malloc(size);
+    // aligned_alloc wants the size in whole multiples of the alignment
+    return aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+inline void* countedAllocateOrThrow(size_t size, size_t alignment) {
+    void* p = countedAllocate(size, alignment);
+    if(p == nullptr) throw bad_alloc();
+    return p;
+}
+
+#define ATTENDANCE_ALLOCATION_COUNTER() \
+    void* operator new(size_t size) { return countedAllocateOrThrow(size, 0); } \
+    void* operator new[](size_t size) { return countedAllocateOrThrow(size, 0); } \
+    void* operator new(size_t size, const nothrow_t&) noexcept { return countedAllocate(size, 0); } \
+    void* operator new[](size_t size, const nothrow_t&) noexcept { return countedAllocate(size, 0); } \
+    void* operator new(size_t size, align_val_t a) { return countedAllocateOrThrow(size, static_cast<size_t>(a)); } \
+    void* operator new[](size_t size, align_val_t a) { return countedAllocateOrThrow(size, static_cast<size_t>(a)); } \
+    void* operator new(size_t size, align_val_t a, const nothrow_t&) noexcept { return countedAllocate(size, static_cast<size_t>(a)); } \
+    void* operator new[](size_t size, align_val_t a, const nothrow_t&) noexcept { return countedAllocate(size, static_cast<size_t>(a)); } \
+    void operator delete(void* p) noexcept { free(p); } \
+    void operator delete[](void* p) noexcept { free(p); } \
+    void operator delete(void* p, size_t) noexcept { free(p); } \
+    void operator delete[](void* p, size_t) noexcept { free(p); } \
+    void operator delete(void* p, const nothrow_t&) noexcept { free(p); } \
+    void operator delete[](void* p, const nothrow_t&) noexcept { free(p); } \
+    void operator delete(void* p, align_val_t) noexcept { free(p); } \
+    void operator delete[](void* p, align_val_t) noexcept { free(p); } \
+    void operator delete(void* p, size_t, align_val_t) noexcept { free(p); } \
+    void operator delete[](void* p, size_t, align_val_t) noexcept { free(p); } \
+    void operator delete(void* p, align_val_t, const nothrow_t&) noexcept { free(p); } \
+    void operator delete[](void* p, align_val_t, const nothrow_t&) noexcept { free(p); }
+#else
+#define STAT_ADD(counter, amount) ((void)0)
+#define STAT_SCOPE(timer) ((void)0)
+#define ATTENDANCE_ALLOCATION_COUNTER()
+
+inline StatTotals statsSnapshot() { return StatTotals(); }
+#endif
+
+// Student Class
+class Student {
+private:
+    string indexNumber;
+    string name;
+    
+public:
+    Student() {}
+    
+    Student(string idx, string n) {
+        indexNumber = move(idx);
+        name = move(n);
+    }
+    
+    const string& getIndexNumber() const { return indexNumber; }
+    const string& getName() const { return name; }
+    
+    void setIndexNumber(string idx) { indexNumber = idx; }
+    void setName(string n) { name = n; }
+    
+    void display() const {
+        cout << "Index: " << indexNumber << " | Name: " << name << endl;
+    }
+    
+    // Convert to CSV format for saving
+    string toCSV() const {
+        return indexNumber + "," + name;
+    }
+    
+    // Create from CSV string
+    static Student fromCSV(string_view csv) {
+        size_t commaPos = csv.find(',');
+        if(commaPos != string_view::npos) {
+            return Student(string(csv.substr(0, commaPos)), string(csv.substr(commaPos + 1)));
+        }
+        return Student();
+    }
+};
+
+// Running per-student totals across all sessions
+struct AttendanceCounts {
+    uint32_t enrolled = 0; // sessions with the student on the roster
+    uint32_t present = 0;
+    uint32_t late = 0;
+    uint32_t absent = 0;
+};
+
+// Memory held by the attendance history, against plain bitmaps
+struct HistoryFootprint {
+    size_t students = 0;    // students with at least one mark
+    size_t columns = 0;     // sessions
+    size_t runs = 0;
+    size_t bytes = 0;       // runs plus per-student and per-course overhead
+    size_t plainBytes = 0;  // three uncompressed bitmaps per student
+};
+
+// Every student's marks across all sessions, for longitudinal queries.
+// Each session is a column, in (date, time, course) order, and each
+// student has one run-length bitmap per status over the columns, so a
+// student present at every lecture of a term is a single run. Built on
+// first use like the totals; markAttendance then keeps it current, and a
+// session created out of date order clears it to be rebuilt.
+class AttendanceHistory {
+private:
+    struct StudentHistory {
+        RunBitmap present;
+        RunBitmap absent;
+        RunBitmap late;
+    };
+    vector<StudentHistory> byStudent; // ID -> history
+    map<string, RunBitmap> courseColumns;
+    uint32_t columnCount = 0;
+    tuple<string, string, string> lastColumn; // (date, time, course)
+    bool ready = false;
+    
+    RunBitmap& plane(StudentHistory& history, AttendanceStatus status) {
+        switch(status) {
+            case PRESENT: return history.present;
+            case LATE: return history.late;
+            default: return history.absent;
+        }
+    }
+    
+    static const StudentHistory& noHistory() {
+        static const StudentHistory empty;
+        return empty;
+    }
+    
+public:
+    bool active() const { return ready; }
+    void activate() { ready = true; }
+    
+    void reset() {
+        vector<StudentHistory>().swap(byStudent);
+        courseColumns.clear();
+        columnCount = 0;
+        lastColumn = {};
+        ready = false;
+    }
+    
+    // Column for a new session, or -1 if it sorts before the last one
+    int addColumn(const string& course, const string& date, const string& time) {
+        tuple<string, string, string> key(date, time, course);
+        if(columnCount > 0 && key < lastColumn) return -1;
+        lastColumn = move(key);
+        courseColumns[course].set(columnCount);
+        return static_cast<int>(columnCount++);
+    }
+    
+    uint32_t columns() const { return columnCount; }
+    
+    // Set a student's mark in a column, replacing any earlier one
+    void record(uint32_t column, uint32_t id, AttendanceStatus status) {
+        if(id >= byStudent.size()) byStudent.resize(id + 1);
+        StudentHistory& history = byStudent[id];
+        history.present.clear(column);
+        history.absent.clear(column);
+        history.late.clear(column);
+        plane(history, status).set(column);
+    }
+    
+    // Release the spare capacity left by building
+    void shrink() {
+        for(auto& history : byStudent) {
+            history.present.shrink();
+            history.absent.shrink();
+            history.late.shrink();
+        }
+    }
+    
+    bool hasCourse(const string& course) const { return courseColumns.count(course) > 0; }
+    
+    // Longest run of ABSENT marks with no PRESENT or LATE mark between
+    // them, over the sessions of course (all sessions when empty)
+    uint32_t longestAbsence(uint32_t id, const string& course) const {
+        const StudentHistory& history = id < byStudent.size() ? byStudent[id] : noHistory();
+        RunBitmap attended = RunBitmap::unite(history.present, history.late);
+        if(course.empty()) return RunBitmap::longestUnbroken(history.absent, attended);
+        auto columns = courseColumns.find(course);
+        if(columns == courseColumns.end()) return 0;
+        return RunBitmap::longestUnbroken(RunBitmap::intersect(history.absent, columns->second),
+                                          RunBitmap::intersect(attended, columns->second));
+    }
+    
+    // Marks of one status and of any status over the sessions of course
+    // (all sessions when empty)
+    void statusShare(uint32_t id, const string& course, AttendanceStatus status, uint32_t& count, uint32_t& marked) const {
+        const StudentHistory& history = id < byStudent.size() ? byStudent[id] : noHistory();
+        const RunBitmap* planes[3] = { &history.present, &history.absent, &history.late }; // enum order
+        const RunBitmap* columns = nullptr;
+        count = 0;
+        marked = 0;
+        if(!course.empty()) {
+            auto found = courseColumns.find(course);
+            if(found == courseColumns.end()) return;
+            columns = &found->second;
+        }
+        for(int i = 0; i < 3; i++) {
+            uint32_t n = columns == nullptr ? planes[i]->count() : RunBitmap::intersect(*planes[i], *columns).count();
+            marked += n;
+            if(i == static_cast<int>(status)) count = n;
+        }
+    }
+    
+    HistoryFootprint footprint() const {
+        HistoryFootprint f;
+        f.columns = columnCount;
+        f.bytes = byStudent.capacity() * sizeof(StudentHistory);
+        for(const auto& history : byStudent) {
+            size_t runs = history.present.runCount() + history.absent.runCount() + history.late.runCount();
+            if(runs > 0) f.students++;
+            f.runs += runs;
+            f.bytes += history.present.memoryBytes() + history.absent.memoryBytes() + history.late.memoryBytes();
+        }
+        for(const auto& course : courseColumns) {
+            f.runs += course.second.runCount();
+            f.bytes += sizeof(course) + course.first.capacity() + course.second.memoryBytes();
+        }
+        f.plainBytes = byStudent.size() * 3 * ((columnCount + 63) / 64) * sizeof(uint64_t);
+        return f;
+    }
+};
+
+// A roster as an immutable, shared snapshot: student IDs in roster order.
+// Sessions hold a reference instead of their own copy, and a snapshot is
+// never changed once built; a different roster is a different snapshot.
+// Numbered versions belong to the registry and are saved to rosters.txt
+// as the students added to their base version; version 0 is a roster
+// private to one session, stored inline in its record.
+struct RosterSnapshot {
+    uint32_t version = 0;
+    uint32_t base = 0;      // version whose IDs start this roster, 0 = none
+    size_t addedFrom = 0;   // ids[addedFrom..] are the delta to base
+    vector<uint32_t> ids;
+};
+
+// StudentRegistry Class - owns every registered student and keeps an
+// open-addressing hash index on the normalized (upper-case) index number,
+// so lookups and inserts are O(1) instead of a scan over the whole roster.
+// Each index number is interned to a dense 32-bit ID (its position in the
+// table), which sessions use instead of storing strings. Index numbers that
+// only appear in session files get a placeholder ID until registered.
+class StudentRegistry {
+private:
+    vector<Student> records;          // ID -> student
+    vector<uint8_t> registeredFlags;  // ID -> 1 if registered, 0 if placeholder
+    size_t registeredCount = 0;
+    vector<int32_t> slots; // -1 = empty slot, otherwise ID
+    vector<uint32_t> unsavedIds; // registered since the last save, in order
+    unsigned version = 0;
+    vector<AttendanceCounts> counts; // ID -> totals, kept once countsReady
+    bool countsReady = false;
+    AttendanceHistory attendanceHistory; // ID -> marks per session, once active
+    vector<shared_ptr<const RosterSnapshot>> rosters; // version - 1 -> snapshot
+    map<pair<size_t, uint64_t>, vector<uint32_t>> rosterVersionsByHash;
+    shared_ptr<const RosterSnapshot> current; // roster of the registered students
+    unsigned currentFor = 0;                  // registry version it was built for, + 1
+    size_t savedRosters = 0;
+    
+    static uint64_t hashIds(const vector<uint32_t>& ids) {
+        uint64_t h = 1469598103934665603ULL;
+        for(uint32_t id : ids) {
+            h ^= id;
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+    
+    shared_ptr<const RosterSnapshot> addRoster(uint32_t base, vector<uint32_t> ids) {
+        auto snapshot = make_shared<RosterSnapshot>();
+        snapshot->version = static_cast<uint32_t>(rosters.size() + 1);
+        snapshot->base = base;
+        snapshot->addedFrom = base == 0 ? 0 : rosters[base - 1]->ids.size();
+        snapshot->ids = move(ids);
+        rosterVersionsByHash[{snapshot->ids.size(), hashIds(snapshot->ids)}].push_back(snapshot->version);
+        rosters.push_back(snapshot);
+        return snapshot;
+    }
+    
+    // Returns the slot holding key, or the empty slot where it belongs;
+    // index numbers compare ignoring case
+    size_t probe(string_view key) const {
+        return probeIndexSlot(slots, key, true, [&](int32_t id) -> const string& { return records[id].getIndexNumber(); });
+    }
+    
+    void rehash(size_t capacity) {
+        slots.assign(capacity, -1);
+        for(size_t i = 0; i < records.size(); i++) {
+            slots[probe(records[i].getIndexNumber())] = static_cast<int32_t>(i);
+        }
+    }
+    
+    // Keep the load factor at or below 1/2
+    void reserveSlots(size_t count) {
+        size_t capacity = indexCapacityFor(count, slots.size());
+        if(capacity != slots.size()) rehash(capacity);
+    }
+    
+    // Add a student at the empty slot probe() returned for its index
+    // number; the caller has already made room with reserveSlots()
+    uint32_t append(Student student, bool registered, size_t slot) {
+        records.push_back(move(student));
+        registeredFlags.push_back(registered ? 1 : 0);
+        counts.emplace_back();
+        uint32_t id = static_cast<uint32_t>(records.size() - 1);
+        slots[slot] = static_cast<int32_t>(id);
+        return id;
+    }
+    
+public:
+    static const int32_t NO_ID = -1;
+    
+    StudentRegistry() {
+        slots.assign(16, -1);
+    }
+    
+    // Number of registered students (placeholders excluded)
+    size_t size() const { return registeredCount; }
+    bool empty() const { return registeredCount == 0; }
+    
+    // Number of IDs handed out, including placeholders
+    size_t idCount() const { return records.size(); }
+    bool isRegistered(uint32_t id) const { return registeredFlags[id] != 0; }
+    const Student& operator[](uint32_t id) const { return records[id]; }
+    
+    // Make room for count students without growing the table again
+    void reserve(size_t count) {
+        records.reserve(count);
+        registeredFlags.reserve(count);
+        counts.reserve(count);
+        reserveSlots(count);
+    }
+    
+    int32_t findId(string_view index) const {
+        STAT_ADD(STAT_LOOKUPS, 1);
+        if(index.empty()) return NO_ID;
+        return slots[probe(index)];
+    }
+    
+    const Student* find(const string& index) const {
+        int32_t id = findId(index);
+        if(id == NO_ID || !registeredFlags[id]) return nullptr;
+        return &records[id];
+    }
+    
+    bool contains(const string& index) const {
+        return find(index) != nullptr;
+    }
+    
+    // Returns the ID for index, handing out a placeholder ID if unknown
+    uint32_t intern(string_view index) {
+        reserveSlots(records.size() + 1);
+        size_t slot = probe(index);
+        if(slots[slot] != NO_ID) return static_cast<uint32_t>(slots[slot]);
+        return append(Student(string(index), ""), false, slot);
+    }
+    
+    // Returns false if a student with the same index number is already
+    // registered. A placeholder with that index number is claimed in place.
+    bool insert(Student student) {
+        if(student.getIndexNumber().empty()) return false;
+        reserveSlots(records.size() + 1);
+        size_t slot = probe(student.getIndexNumber());
+        int32_t id = slots[slot];
+        if(id == NO_ID) {
+            id = static_cast<int32_t>(append(move(student), false, slot));
+        } else if(registeredFlags[id]) {
+            return false;
+        } else {
+            records[id] = move(student);
+        }
+        registeredFlags[id] = 1;
+        registeredCount++;
+        unsavedIds.push_back(static_cast<uint32_t>(id));
+        version++;
+        return true;
+    }
+    
+    // Take over a table of students read from students.txt as already
+    // saved. An empty registry adopts the vector itself, compacting out
+    // blank rows and repeated index numbers in place; otherwise the rows
+    // are inserted one by one. Returns the table position and index
+    // number of every row dropped because its index number was taken.
+    vector<pair<size_t, string>> loadSaved(vector<Student>&& table) {
+        vector<pair<size_t, string>> repeated;
+        if(!records.empty()) {
+            size_t unsavedBefore = unsavedIds.size();
+            reserve(records.size() + table.size());
+            for(size_t i = 0; i < table.size(); i++) {
+                string index = table[i].getIndexNumber();
+                if(!insert(move(table[i])) && !index.empty()) repeated.push_back({i, index});
+            }
+            unsavedIds.resize(unsavedBefore);
+            return repeated;
+        }
+        
+        records = move(table);
+        slots.assign(indexCapacityFor(records.size(), 0), -1);
+        size_t kept = 0;
+        for(size_t i = 0; i < records.size(); i++) {
+            if(records[i].getIndexNumber().empty()) continue;
+            size_t slot = probe(records[i].getIndexNumber());
+            if(slots[slot] != NO_ID) {
+                repeated.push_back({i, records[i].getIndexNumber()});
+                continue;
+            }
+            if(kept != i) records[kept] = move(records[i]);
+            slots[slot] = static_cast<int32_t>(kept);
+            kept++;
+        }
+        records.resize(kept);
+        registeredFlags.assign(kept, 1);
+        counts.assign(kept, AttendanceCounts());
+        attendanceHistory.reset();
+        registeredCount = kept;
+        version++;
+        return repeated;
+    }
+    
+    // Dirty tracking for incremental saves
+    unsigned getVersion() const { return version; }
+    const vector<uint32_t>& getUnsavedIds() const { return unsavedIds; }
+    void markSaved() { unsavedIds.clear(); }
+    
+    // Per-student attendance totals. Sessions update them as marks change
+    // once they are ready; until then they are empty.
+    bool countsActive() const { return countsReady; }
+    const AttendanceCounts& getCounts(uint32_t id) const { return counts[id]; }
+    AttendanceCounts& countsFor(uint32_t id) { return counts[id]; }
+    
+    void resetCounts() {
+        counts.assign(records.size(), AttendanceCounts());
+        countsReady = false;
+    }
+    
+    void activateCounts() { countsReady = true; }
+    
+    // Per-student history over the sessions; sessions record their marks
+    // in it once it is active
+    AttendanceHistory& history() { return attendanceHistory; }
+    const AttendanceHistory& history() const { return attendanceHistory; }
+    
+    // The roster of every registered student, in ID order. Sessions
+    // created while the registry is unchanged share one snapshot.
+    shared_ptr<const RosterSnapshot> currentRoster() {
+        if(current != nullptr && currentFor == version + 1) return current;
+        vector<uint32_t> ids;
+        ids.reserve(registeredCount);
+        for(uint32_t id = 0; id < records.size(); id++) {
+            if(registeredFlags[id]) ids.push_back(id);
+        }
+        current = shareRoster(move(ids));
+        currentFor = version + 1;
+        return current;
+    }
+    
+    // The numbered snapshot holding exactly ids, made if there is none.
+    // A new one extending the latest version records only the delta.
+    shared_ptr<const RosterSnapshot> shareRoster(vector<uint32_t> ids) {
+        auto found = rosterVersionsByHash.find({ids.size(), hashIds(ids)});
+        if(found != rosterVersionsByHash.end()) {
+            for(uint32_t v : found->second) {
+                if(rosters[v - 1]->ids == ids) return rosters[v - 1];
+            }
+        }
+        uint32_t base = 0;
+        if(!rosters.empty()) {
+            const vector<uint32_t>& latest = rosters.back()->ids;
+            if(latest.size() <= ids.size() && equal(latest.begin(), latest.end(), ids.begin())) {
+                base = static_cast<uint32_t>(rosters.size());
+            }
+        }
+        return addRoster(base, move(ids));
+    }
+    
+    // A numbered snapshot, or nullptr if there is no such version
+    shared_ptr<const RosterSnapshot> rosterVersion(uint32_t v) const {
+        return v >= 1 && v <= rosters.size() ? rosters[v - 1] : nullptr;
+    }
+    
+    size_t rosterCount() const { return rosters.size(); }
+    
+    // Re-create a version read from rosters.txt; versions come in order
+    // and extend a base already loaded. False if out of sequence.
+    bool loadRoster(uint32_t v, uint32_t base, const vector<uint32_t>& added) {
+        if(v != rosters.size() + 1 || base > rosters.size()) return false;
+        vector<uint32_t> ids;
+        if(base > 0) ids = rosters[base - 1]->ids;
+        ids.insert(ids.end(), added.begin(), added.end());
+        addRoster(base, move(ids));
+        savedRosters = rosters.size();
+        return true;
+    }
+    
+    // rosters.txt rows of the versions made since the last save:
+    // VERSION,BASE,INDEX,... listing only the students added to BASE
+    string unsavedRosterRows() const {
+        string rows;
+        for(size_t i = savedRosters; i < rosters.size(); i++) {
+            const RosterSnapshot& snapshot = *rosters[i];
+            rows += to_string(snapshot.version) + "," + to_string(snapshot.base);
+            for(size_t k = snapshot.addedFrom; k < snapshot.ids.size(); k++) {
+                rows += ',';
+                rows += records[snapshot.ids[k]].getIndexNumber();
+            }
+            rows += '\n';
+        }
+        return rows;
+    }
+    
+    bool hasUnsavedRosters() const { return savedRosters < rosters.size(); }
+    void markRostersSaved() { savedRosters = rosters.size(); }
+};
+
+// Files and bytes written by one save
+struct SaveStats {
+    int filesWritten = 0;
+    size_t bytesWritten = 0;
+    int recordsWritten = 0;
+    int sessionsSkipped = 0;
+};
+
+// Popcount over an array of 64-bit words. Uses an AVX2 nibble-lookup kernel
+// when the CPU supports it and a portable per-word count otherwise.
+inline size_t popcountWordsPortable(const uint64_t* words, size_t count) {
+    size_t total = 0;
+    for(size_t i = 0; i < count; i++) {
+        total += bitset<64>(words[i]).count();
+    }
+    return total;
+}
+
+#ifdef ATTENDANCE_X86_DISPATCH
+__attribute__((target("avx2")))
+inline size_t popcountWordsAVX2(const uint64_t* words, size_t count) {
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i lowMask = _mm256_set1_epi8(0x0f);
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i));
+        __m256i lo = _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, lowMask));
+        __m256i hi = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), lowMask));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256()));
+    }
+    size_t total = static_cast<size_t>(_mm256_extract_epi64(acc, 0)) + static_cast<size_t>(_mm256_extract_epi64(acc, 1))
+                 + static_cast<size_t>(_mm256_extract_epi64(acc, 2)) + static_cast<size_t>(_mm256_extract_epi64(acc, 3));
+    return total + popcountWordsPortable(words + i, count - i);
+}
+#endif
+
+inline size_t popcountWords(const vector<uint64_t>& words) {
+#ifdef ATTENDANCE_X86_DISPATCH
+    static const bool hasAVX2 = __builtin_cpu_supports("avx2");
+    if(hasAVX2) return popcountWordsAVX2(words.data(), words.size());
+#endif
+    return popcountWordsPortable(words.data(), words.size());
+}
+
+// Positions of the '\n' and ',' bytes in a block of up to 64 bytes, one
+// bit per byte. Used to split students.txt into rows without a per-byte
+// loop when the CPU has SSE2 or AVX2.
+struct DelimiterMasks {
+    uint64_t newlines;
+    uint64_t commas;
+};
+
+inline DelimiterMasks delimiterMasksPortable(const char* block, size_t length) {
+    DelimiterMasks masks = { 0, 0 };
+    for(size_t i = 0; i < length; i++) {
+        if(block[i] == '\n') masks.newlines |= 1ULL << i;
+        else if(block[i] == ',') masks.commas |= 1ULL << i;
+    }
+    return masks;
+}
+
+#ifdef ATTENDANCE_X86_DISPATCH
+inline DelimiterMasks delimiterMasksSSE2(const char* block, size_t) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i comma = _mm_set1_epi8(',');
+    DelimiterMasks masks = { 0, 0 };
+    for(int i = 0; i < 4; i++) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i));
+        masks.newlines |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)))) << (16 * i);
+        masks.commas |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, comma)))) << (16 * i);
+    }
+    return masks;
+}
+
+__attribute__((target("avx2")))
+inline DelimiterMasks delimiterMasksAVX2(const char* block, size_t) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i comma = _mm256_set1_epi8(',');
+    __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+    __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32));
+    DelimiterMasks masks;
+    masks.newlines = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, newline)))
+                   | static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, newline)))) << 32;
+    masks.commas = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, comma)))
+                 | static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, comma)))) << 32;
+    return masks;
+}
+#endif
+
+typedef DelimiterMasks (*DelimiterKernel)(const char*, size_t);
+
+// Kernel for full 64-byte blocks; name is set to the one chosen
+inline DelimiterKernel selectDelimiterKernel(const char** name = nullptr) {
+    const char* chosen = "portable";
+    DelimiterKernel kernel = delimiterMasksPortable;
+#ifdef ATTENDANCE_X86_DISPATCH
+    static const bool hasAVX2 = __builtin_cpu_supports("avx2");
+    if(hasAVX2) {
+        chosen = "AVX2";
+        kernel = delimiterMasksAVX2;
+    } else {
+        chosen = "SSE2";
+        kernel = delimiterMasksSSE2;
+    }
+#endif
+    if(name != nullptr) *name = chosen;
+    return kernel;
+}
+
+// One line of students.txt as offsets into the file buffer. comma is the
+// first ',' on the line, or end when there is none.
+struct StudentRowSpan {
+    size_t start;
+    size_t comma;
+    size_t end;
+};
+
+// Split text[begin, end) into lines; begin must be the start of a line
+inline void scanStudentRows(const char* text, size_t begin, size_t end, vector<StudentRowSpan>& rows) {
+    DelimiterKernel kernel = selectDelimiterKernel();
+    StudentRowSpan row = { begin, 0, 0 };
+    bool haveComma = false;
+    for(size_t pos = begin; pos < end; pos += 64) {
+        size_t length = min<size_t>(64, end - pos);
+        DelimiterMasks masks = length == 64 ? kernel(text + pos, 64) : delimiterMasksPortable(text + pos, length);
+        uint64_t bits = masks.newlines | masks.commas;
+        while(bits != 0) {
+            int bit = __builtin_ctzll(bits);
+            bits &= bits - 1;
+            size_t at = pos + bit;
+            if((masks.newlines >> bit) & 1) {
+                if(!haveComma) row.comma = at;
+                row.end = at;
+                rows.push_back(row);
+                row.start = at + 1;
+                haveComma = false;
+            } else if(!haveComma) {
+                row.comma = at;
+                haveComma = true;
+            }
+        }
+    }
+    if(row.start < end) {
+        if(!haveComma) row.comma = end;
+        row.end = end;
+        rows.push_back(row);
+    }
+}
+
+// Build the registry from the text of students.txt ("INDEX,NAME" lines).
+// Rows are found with the vectorized delimiter scan and the Student
+// table is built in one pre-sized vector; with threads > 1 a large file
+// is split at line boundaries and the chunks are scanned and built in
+// parallel. Students are then indexed in file order. Malformed lines, and
+// lines repeating an index number of an earlier line, are skipped and
+// returned in errors.
+inline void loadStudentsBulk(const string& text, StudentRegistry& registry, vector<ParseError>& errors, unsigned threads) {
+    const size_t MIN_CHUNK_BYTES = 1 << 20;
+    size_t chunkLimit = max<size_t>(text.size() / MIN_CHUNK_BYTES, 1);
+    size_t chunkCount = min<size_t>(max(threads, 1u), chunkLimit);
+    
+    vector<size_t> bounds(1, 0);
+    for(size_t c = 1; c < chunkCount; c++) {
+        size_t nominal = text.size() / chunkCount * c;
+        if(nominal <= bounds.back()) continue;
+        const void* newline = memchr(text.data() + nominal, '\n', text.size() - nominal);
+        size_t bound = newline == nullptr ? text.size() : static_cast<const char*>(newline) - text.data() + 1;
+        if(bound > bounds.back() && bound < text.size()) bounds.push_back(bound);
+    }
+    bounds.push_back(text.size());
+    chunkCount = bounds.size() - 1;
+    
+    auto runChunks = [&](const function<void(size_t)>& work) {
+        vector<thread> pool;
+        for(size_t c = 1; c < chunkCount; c++) {
+            pool.emplace_back(work, c);
+        }
+        work(0);
+        for(auto& th : pool) {
+            th.join();
+        }
+    };
+    
+    vector<vector<StudentRowSpan>> spans(chunkCount);
+    runChunks([&](size_t c) {
+        spans[c].reserve((bounds[c + 1] - bounds[c]) / 16 + 1);
+        scanStudentRows(text.data(), bounds[c], bounds[c + 1], spans[c]);
+    });
+    
+    vector<size_t> firstRow(chunkCount + 1, 0);
+    for(size_t c = 0; c < chunkCount; c++) {
+        firstRow[c + 1] = firstRow[c] + spans[c].size();
+    }
+    
+    vector<Student> table(firstRow[chunkCount]);
+    vector<vector<ParseError>> chunkErrors(chunkCount);
+    runChunks([&](size_t c) {
+        for(size_t r = 0; r < spans[c].size(); r++) {
+            const StudentRowSpan& span = spans[c][r];
+            string_view line(text.data() + span.start, span.end - span.start);
+            if(!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            if(trimField(line).empty()) continue;
+            size_t comma = span.comma - span.start;
+            if(comma >= line.size() || trimField(line.substr(0, comma)).empty()) {
+                chunkErrors[c].push_back({firstRow[c] + r + 1, "expected INDEX,NAME"});
+                continue;
+            }
+            table[firstRow[c] + r] = Student(string(line.substr(0, comma)), string(line.substr(comma + 1)));
+        }
+    });
+    
+    vector<pair<size_t, string>> repeated = registry.loadSaved(move(table));
+    for(auto& chunk : chunkErrors) {
+        errors.insert(errors.end(), chunk.begin(), chunk.end());
+    }
+    if(!repeated.empty()) {
+        for(const auto& row : repeated) {
+            errors.push_back({row.first + 1, "index number " + row.second + " already on an earlier line"});
+        }
+        stable_sort(errors.begin(), errors.end(), [](const ParseError& a, const ParseError& b) { return a.line < b.line; });
+    }
+}
+
+// Binary session file layout (format version 3, native byte order):
+//   SessionFileHeader
+//   uint32_t nameOffsets[nameCount + 1]  offsets of each index number in text
+//   char     text[textBytes]             course, date, time, duration, index numbers
+//   padding to 8 bytes
+//   uint32_t roster[rosterCount]         name numbers in roster order
+//   padding to 8 bytes
+//   uint64_t planes[3][planeWords]       PRESENT, ABSENT, LATE bits by member number
+// With rosterVersion 0 the roster is stored inline: names are numbered
+// per file, the roster in order and then any other marked students, and
+// members are names. Otherwise the roster is that shared version from
+// rosters.txt and is not stored at all: members are its students in
+// order, then the names, which are only the marked students outside it.
+// The header also caches the summary counts and a CRC-32 of the whole
+// record, taken with the checksum field zero and checked when the record
+// is read. Format version 2 is the same without the checksum; version 1
+// also lacks the roster version and always has the roster inline.
+const char SESSION_MAGIC[4] = { 'A', 'T', 'S', 'B' };
+const uint32_t SESSION_FORMAT_VERSION = 3;
+
+struct SessionFileHeader {
+    char magic[4];
+    uint32_t formatVersion;
+    uint32_t nameCount;
+    uint32_t rosterCount;
+    uint32_t planeWords;
+    uint32_t textBytes;
+    uint32_t presentCount;
+    uint32_t absentCount;
+    uint32_t lateCount;
+    uint32_t markedCount;
+    uint16_t courseLength;
+    uint16_t dateLength;
+    uint16_t timeLength;
+    uint16_t durationLength;
+    uint32_t rosterVersion;  // shared roster version, 0 = stored inline
+    uint32_t checksum;       // from format version 3
+};
+
+// Header size of format version 1 records
+const size_t SESSION_HEADER_V1_SIZE = offsetof(SessionFileHeader, rosterVersion);
+
+// CRC-32 of an encoded record, with its checksum field taken as zero
+inline uint32_t sessionRecordChecksum(const char* data, size_t size) {
+    const size_t field = offsetof(SessionFileHeader, checksum);
+    const char zero[sizeof(uint32_t)] = {};
+    uint32_t crc = crc32(data, field);
+    crc = crc32(zero, sizeof(zero), crc);
+    return crc32(data + field + sizeof(zero), size - field - sizeof(zero), crc);
+}
+
+inline size_t alignTo8(size_t offset) {
+    return (offset + 7) & ~static_cast<size_t>(7);
+}
+
+// Consolidated session store: every session lives in one data file as a
+// record in the binary session format above, and one index file maps
+// (courseCode, date, startTime) to the record. Index entries are fixed-size
+// so they can be appended and updated in place; when a key appears more than
+// once the last entry wins. Index entries also cache the summary counts, so
+// the session list can be shown without reading the data file.
+//
+// New records are appended and only become live when the index entry
+// pointing at them is written, after they are synced. Everything written
+// over live data (a record rewritten in place, an index entry) goes
+// through a double-write buffer in sessions.dat.dwb, so a write torn by a
+// crash is written again when the store is next opened.
+const char STORE_INDEX_MAGIC[4] = { 'A', 'T', 'S', 'I' };
+const uint32_t STORE_INDEX_VERSION = 1;
+
+struct StoreIndexHeader {
+    char magic[4];
+    uint32_t formatVersion;
+    uint32_t entrySize;
+    uint32_t reserved;
+};
+
+struct StoreIndexEntry {
+    char courseCode[32];
+    char date[16];
+    char startTime[8];
+    char duration[8];
+    uint64_t offset;
+    uint64_t length;
+    uint32_t presentCount;
+    uint32_t absentCount;
+    uint32_t lateCount;
+    uint32_t markedCount;
+};
+
+// Longest course code that fits an index entry
+const size_t MAX_COURSE_CODE_LENGTH = sizeof(StoreIndexEntry::courseCode) - 1;
+
+class SessionStore {
+private:
+    string dataFilename;
+    string indexFilename;
+    int dataFd = -1;
+    int indexFd = -1;
+    uint64_t dataEnd = 0;
+    vector<StoreIndexEntry> entries;    // one per index entry, in file order
+    map<string, int> liveSlots;         // key -> latest entry
+    map<string, unsigned> liveVersions; // key -> session version written since open()
+    vector<int> pendingEntries;         // entries to write to the index at sync()
+    DoubleWriteBuffer overwrites;       // in-place writes waiting for sync()
+    long recovered = 0;                 // writes replayed by open()
+    // Reads, writes and syncs may come from different threads (the
+    // compactor writes without dataMutex); open() and close() may not
+    mutable mutex storeMutex;
+    
+    // Files overwrites and the double-write buffer refer to
+    enum { DATA_TARGET = 0, INDEX_TARGET = 1 };
+    
+    static string fieldToString(const char* field, size_t size) {
+        return string(field, strnlen(field, size));
+    }
+    
+    static void stringToField(const string& value, char* field, size_t size) {
+        memset(field, 0, size);
+        memcpy(field, value.data(), min(value.size(), size - 1));
+    }
+    
+    static bool writeAll(int fd, const char* data, size_t size, uint64_t offset) {
+        STAT_ADD(STAT_BYTES_WRITTEN, size);
+        while(size > 0) {
+            ssize_t written = pwrite(fd, data, size, static_cast<off_t>(offset));
+            if(written <= 0) return false;
+            data += written;
+            size -= static_cast<size_t>(written);
+            offset += static_cast<uint64_t>(written);
+        }
+        return true;
+    }
+    
+    static off_t entryPosition(int slot) {
+        return static_cast<off_t>(sizeof(StoreIndexHeader) + static_cast<size_t>(slot) * sizeof(StoreIndexEntry));
+    }
+    
+    int findSlot(const string& key) const {
+        STAT_ADD(STAT_LOOKUPS, 1);
+        auto it = liveSlots.find(key);
+        return it == liveSlots.end() ? -1 : it->second;
+    }
+    
+    // Apply the in-place writes not yet synced to a record read from disk
+    void overlayPending(uint64_t offset, string& buffer) const {
+        for(const auto& write : overwrites.pending()) {
+            if(write.target != DATA_TARGET) continue;
+            uint64_t start = max(offset, write.offset);
+            uint64_t end = min(offset + buffer.size(), write.offset + write.data.size());
+            if(start >= end) continue;
+            memcpy(&buffer[start - offset], write.data.data() + (start - write.offset), end - start);
+        }
+    }
+    
+public:
+    static string makeKey(const string& courseCode, const string& date, const string& startTime) {
+        return courseCode + "\t" + date + "\t" + startTime;
+    }
+    
+    ~SessionStore() {
+        close();
+    }
+    
+    // Close the files and forget the index; open() may be called again
+    void close() {
+        if(dataFd >= 0) ::close(dataFd);
+        if(indexFd >= 0) ::close(indexFd);
+        dataFd = indexFd = -1;
+        dataEnd = 0;
+        entries.clear();
+        liveSlots.clear();
+        pendingEntries.clear();
+        liveVersions.clear();
+        overwrites.close();
+        recovered = 0;
+    }
+    
+    // Open (creating if needed) the data and index files and read the index
+    bool open(const string& dataFile, const string& indexFile) {
+        dataFilename = dataFile;
+        indexFilename = indexFile;
+        dataFd = ::open(dataFile.c_str(), O_RDWR | O_CREAT, 0644);
+        indexFd = ::open(indexFile.c_str(), O_RDWR | O_CREAT, 0644);
+        if(dataFd < 0 || indexFd < 0) {
+            return false;
+        }
+        
+        // Finish the in-place writes of a save a crash interrupted
+        if(!overwrites.open(dataFile + ".dwb")) return false;
+        recovered = overwrites.recover({dataFd, indexFd});
+        if(recovered < 0) return false;
+        
+        struct stat info;
+        if(fstat(dataFd, &info) != 0) return false;
+        dataEnd = static_cast<uint64_t>(info.st_size);
+        if(fstat(indexFd, &info) != 0) return false;
+        size_t indexSize = static_cast<size_t>(info.st_size);
+        
+        StoreIndexHeader header;
+        if(indexSize == 0) {
+            memcpy(header.magic, STORE_INDEX_MAGIC, 4);
+            header.formatVersion = STORE_INDEX_VERSION;
+            header.entrySize = sizeof(StoreIndexEntry);
+            header.reserved = 0;
+            // New files: make the header and both directory entries durable
+            return writeAll(indexFd, reinterpret_cast<const char*>(&header), sizeof(header), 0)
+                && fdatasync(indexFd) == 0 && syncDirectory(parentDirectory(indexFile))
+                && syncDirectory(parentDirectory(dataFile));
+        }
+        
+        string buffer(indexSize, '\0');
+        if(pread(indexFd, &buffer[0], indexSize, 0) != static_cast<ssize_t>(indexSize)) {
+            return false;
+        }
+        memcpy(&header, buffer.data(), min(indexSize, sizeof(header)));
+        if(indexSize < sizeof(header) || memcmp(header.magic, STORE_INDEX_MAGIC, 4) != 0
+           || header.formatVersion != STORE_INDEX_VERSION || header.entrySize != sizeof(StoreIndexEntry)) {
+            return false;
+        }
+        
+        // A partially written trailing entry is ignored
+        size_t count = (indexSize - sizeof(header)) / sizeof(StoreIndexEntry);
+        entries.resize(count);
+        memcpy(entries.data(), buffer.data() + sizeof(header), count * sizeof(StoreIndexEntry));
+        for(size_t i = 0; i < count; i++) {
+            if(entries[i].offset + entries[i].length > dataEnd) continue; // record never reached disk
+            liveSlots[makeKey(fieldToString(entries[i].courseCode, sizeof(entries[i].courseCode)),
+                              fieldToString(entries[i].date, sizeof(entries[i].date)),
+                              fieldToString(entries[i].startTime, sizeof(entries[i].startTime)))] = static_cast<int>(i);
+        }
+        return true;
+    }
+    
+    // Latest entry of every session, in index order
+    vector<int> liveEntries() const {
+        lock_guard<mutex> lock(storeMutex);
+        vector<int> slots;
+        slots.reserve(liveSlots.size());
+        for(const auto& item : liveSlots) slots.push_back(item.second);
+        sort(slots.begin(), slots.end());
+        return slots;
+    }
+    
+    // Number of in-place writes open() had to write again after a crash
+    long recoveredWrites() const { return recovered; }
+    
+    // Entries as loaded; only read while the data is being loaded
+    const StoreIndexEntry& entry(int slot) const { return entries[slot]; }
+    string entryCourseCode(int slot) const { return fieldToString(entries[slot].courseCode, sizeof(entries[slot].courseCode)); }
+    string entryDate(int slot) const { return fieldToString(entries[slot].date, sizeof(entries[slot].date)); }
+    string entryStartTime(int slot) const { return fieldToString(entries[slot].startTime, sizeof(entries[slot].startTime)); }
+    string entryDuration(int slot) const { return fieldToString(entries[slot].duration, sizeof(entries[slot].duration)); }
+    
+    int find(const string& courseCode, const string& date, const string& startTime) const {
+        lock_guard<mutex> lock(storeMutex);
+        return findSlot(makeKey(courseCode, date, startTime));
+    }
+    
+    // Point read of one record
+    bool readRecord(int slot, string& buffer) const {
+        lock_guard<mutex> lock(storeMutex);
+        const StoreIndexEntry& e = entries[slot];
+        STAT_ADD(STAT_BYTES_READ, e.length);
+        buffer.resize(e.length);
+        if(e.length > 0 && pread(dataFd, &buffer[0], e.length, static_cast<off_t>(e.offset)) != static_cast<ssize_t>(e.length)) {
+            return false;
+        }
+        overlayPending(e.offset, buffer);
+        return true;
+    }
+    
+    // Read many records with one batch; ok[i] tells whether slots[i] was read
+    bool readRecords(const vector<int>& slots, vector<string>& buffers, vector<char>& ok) const {
+        lock_guard<mutex> lock(storeMutex);
+        buffers.resize(slots.size());
+        ok.assign(slots.size(), 1);
+        BatchIo batch;
+        vector<size_t> queued;
+        for(size_t i = 0; i < slots.size(); i++) {
+            const StoreIndexEntry& e = entries[slots[i]];
+            STAT_ADD(STAT_BYTES_READ, e.length);
+            buffers[i].resize(e.length);
+            if(e.length == 0) continue;
+            batch.read(dataFd, &buffers[i][0], e.length, e.offset);
+            queued.push_back(i);
+        }
+        bool all = batch.run();
+        for(size_t q = 0; q < queued.size(); q++) {
+            ok[queued[q]] = batch.ok(q);
+        }
+        if(!overwrites.empty()) {
+            for(size_t i = 0; i < slots.size(); i++) overlayPending(entries[slots[i]].offset, buffers[i]);
+        }
+        return all;
+    }
+    
+    // An encoded session record to store with writeRecords(), and the
+    // session version it holds
+    struct RecordWrite {
+        const string* record;
+        string courseCode, date, startTime, duration;
+        unsigned version;
+    };
+    
+    // Store an encoded session record and return its slot, or -1 on error
+    int writeRecord(const string& record, const string& courseCode, const string& date,
+                    const string& startTime, const string& duration, unsigned version, SaveStats* stats) {
+        return writeRecords({{&record, courseCode, date, startTime, duration, version}}, stats)[0];
+    }
+    
+    // Whether a session's key and duration fit an index entry unchanged;
+    // a longer field would be cut short and the record stored under
+    // another key
+    static bool fitsIndex(const string& courseCode, const string& date, const string& startTime,
+                          const string& duration) {
+        return courseCode.size() < sizeof(StoreIndexEntry::courseCode) && date.size() < sizeof(StoreIndexEntry::date)
+            && startTime.size() < sizeof(StoreIndexEntry::startTime) && duration.size() < sizeof(StoreIndexEntry::duration);
+    }
+    
+    // Store encoded records of distinct sessions and return their slots,
+    // -1 for any that could not be written or do not fit the index. A
+    // record of an older version than one already written for its
+    // session, by a thread that got to the store first, is skipped; its
+    // slot is that of the newer record. If a key already has a record
+    // with the same layout (same length and same bytes up to the status
+    // planes) only the header and planes are rewritten in place; otherwise
+    // the record is appended. Records go WRITE_BATCH at a time, the
+    // comparison reads as one batch and the appends as another, so the
+    // buffers compared stay small. In-place writes and index changes are
+    // written by sync(), through the double-write buffer; reads see them
+    // before that.
+    static const size_t WRITE_BATCH = 256;
+    
+    vector<int> writeRecords(const vector<RecordWrite>& records, SaveStats* stats) {
+        lock_guard<mutex> lock(storeMutex);
+        vector<int> slots;
+        slots.reserve(records.size());
+        for(size_t first = 0; first < records.size(); first += WRITE_BATCH) {
+            vector<RecordWrite> chunk(records.begin() + first, records.begin() + min(records.size(), first + WRITE_BATCH));
+            vector<int> written = writeRecordBatch(chunk, stats);
+            slots.insert(slots.end(), written.begin(), written.end());
+        }
+        return slots;
+    }
+    
+private:
+    vector<int> writeRecordBatch(const vector<RecordWrite>& records, SaveStats* stats) {
+        vector<int> slots(records.size());
+        vector<size_t> planesOffsets(records.size());
+        vector<string> existing(records.size());
+        vector<char> skipped(records.size(), 0); // superseded, or does not fit the index
+        BatchIo compare;
+        vector<size_t> compared;
+        for(size_t i = 0; i < records.size(); i++) {
+            if(!fitsIndex(records[i].courseCode, records[i].date, records[i].startTime, records[i].duration)) {
+                slots[i] = -1;
+                skipped[i] = 1;
+                continue;
+            }
+            const string& record = *records[i].record;
+            SessionFileHeader header;
+            memcpy(&header, record.data(), sizeof(header));
+            planesOffsets[i] = record.size() - 3 * static_cast<size_t>(header.planeWords) * sizeof(uint64_t);
+            string key = makeKey(records[i].courseCode, records[i].date, records[i].startTime);
+            slots[i] = findSlot(key);
+            auto written = liveVersions.find(key);
+            if(written != liveVersions.end() && written->second > records[i].version) {
+                skipped[i] = 1;
+                continue;
+            }
+            liveVersions[key] = records[i].version;
+            if(slots[i] >= 0 && entries[slots[i]].length == record.size()) {
+                existing[i].resize(planesOffsets[i]);
+                compare.read(dataFd, &existing[i][0], existing[i].size(), entries[slots[i]].offset);
+                compared.push_back(i);
+            }
+        }
+        compare.run();
+        vector<char> inPlace(records.size(), 0);
+        for(size_t c = 0; c < compared.size(); c++) {
+            size_t i = compared[c];
+            inPlace[i] = compare.ok(c)
+                      && existing[i].compare(0, 8, *records[i].record, 0, 8) == 0 // magic and format version
+                      && existing[i].compare(sizeof(SessionFileHeader), string::npos, *records[i].record,
+                                             sizeof(SessionFileHeader), existing[i].size() - sizeof(SessionFileHeader)) == 0;
+        }
+        
+        BatchIo appends;
+        vector<long> appendOf(records.size(), -1);
+        vector<uint64_t> offsets(records.size());
+        for(size_t i = 0; i < records.size(); i++) {
+            if(skipped[i]) continue;
+            const string& record = *records[i].record;
+            if(inPlace[i]) {
+                offsets[i] = entries[slots[i]].offset;
+                overwrites.add(DATA_TARGET, offsets[i], record.data(), sizeof(SessionFileHeader));
+                overwrites.add(DATA_TARGET, offsets[i] + planesOffsets[i], record.data() + planesOffsets[i],
+                               record.size() - planesOffsets[i]);
+                STAT_ADD(STAT_BYTES_WRITTEN, sizeof(SessionFileHeader) + (record.size() - planesOffsets[i]));
+            } else {
+                offsets[i] = alignTo8(dataEnd);
+                dataEnd = offsets[i] + record.size();
+                appendOf[i] = static_cast<long>(appends.size());
+                appends.write(dataFd, record.data(), record.size(), offsets[i]);
+                STAT_ADD(STAT_BYTES_WRITTEN, record.size());
+            }
+        }
+        if(appends.size() > 0) {
+            durableFaultPoint();
+            appends.run();
+        }
+        
+        for(size_t i = 0; i < records.size(); i++) {
+            if(skipped[i]) continue;
+            if(appendOf[i] >= 0 && !appends.ok(static_cast<size_t>(appendOf[i]))) {
+                slots[i] = -1;
+                continue;
+            }
+            const string& record = *records[i].record;
+            SessionFileHeader header;
+            memcpy(&header, record.data(), sizeof(header));
+            if(inPlace[i]) {
+                if(stats != nullptr) stats->bytesWritten += sizeof(header) + (record.size() - planesOffsets[i]);
+            } else {
+                if(stats != nullptr) stats->bytesWritten += record.size();
+                StoreIndexEntry e;
+                memset(&e, 0, sizeof(e));
+                stringToField(records[i].courseCode, e.courseCode, sizeof(e.courseCode));
+                stringToField(records[i].date, e.date, sizeof(e.date));
+                stringToField(records[i].startTime, e.startTime, sizeof(e.startTime));
+                stringToField(records[i].duration, e.duration, sizeof(e.duration));
+                e.offset = offsets[i];
+                e.length = record.size();
+                entries.push_back(e);
+                slots[i] = static_cast<int>(entries.size() - 1);
+                liveSlots[makeKey(records[i].courseCode, records[i].date, records[i].startTime)] = slots[i];
+            }
+            StoreIndexEntry& e = entries[slots[i]];
+            e.presentCount = header.presentCount;
+            e.absentCount = header.absentCount;
+            e.lateCount = header.lateCount;
+            e.markedCount = header.markedCount;
+            pendingEntries.push_back(slots[i]);
+            if(stats != nullptr) stats->recordsWritten++;
+        }
+        return slots;
+    }
+    
+public:
+    // Make appended records durable, stage the in-place writes and the
+    // index entries in the double-write buffer, then write them in place
+    // and sync. Returns false if anything failed; the writes stay pending
+    // for the next sync().
+    bool sync(SaveStats* stats) {
+        lock_guard<mutex> lock(storeMutex);
+        if(pendingEntries.empty() && overwrites.empty()) return true;
+        if(fdatasync(dataFd) != 0) return false;
+        
+        sort(pendingEntries.begin(), pendingEntries.end());
+        pendingEntries.erase(unique(pendingEntries.begin(), pendingEntries.end()), pendingEntries.end());
+        for(int slot : pendingEntries) {
+            overwrites.add(INDEX_TARGET, static_cast<uint64_t>(entryPosition(slot)),
+                           reinterpret_cast<const char*>(&entries[slot]), sizeof(StoreIndexEntry));
+        }
+        if(!overwrites.stage()) return false;
+        
+        // Records first, then the index, so a crash between the two is
+        // the case the double-write buffer repairs
+        BatchIo records;
+        BatchIo index;
+        for(const auto& write : overwrites.pending()) {
+            BatchIo& batch = write.target == DATA_TARGET ? records : index;
+            batch.write(write.target == DATA_TARGET ? dataFd : indexFd, write.data.data(), write.data.size(), write.offset);
+        }
+        durableFaultPoint();
+        if(!records.run()) return false;
+        durableFaultPoint();
+        if(!index.run() || fdatasync(dataFd) != 0 || fdatasync(indexFd) != 0) return false;
+        overwrites.finish();
+        
+        STAT_ADD(STAT_BYTES_WRITTEN, pendingEntries.size() * sizeof(StoreIndexEntry));
+        STAT_ADD(STAT_FILES_WRITTEN, 3);
+        if(stats != nullptr) {
+            stats->filesWritten += 3;
+            stats->bytesWritten += pendingEntries.size() * sizeof(StoreIndexEntry);
+        }
+        pendingEntries.clear();
+        return true;
+    }
+};
+
+// AttendanceSession Class
+// The roster is a shared snapshot of registry IDs and the marks are one
+// bitplane per status, indexed by ID, so summaries are plain popcounts.
+class AttendanceSession {
+private:
+    string courseCode;
+    string date;
+    string startTime;
+    string duration;
+    StudentRegistry* registry = nullptr;
+    shared_ptr<const RosterSnapshot> roster; // nullptr = no students
+    vector<uint64_t> presentBits;
+    vector<uint64_t> absentBits;
+    vector<uint64_t> lateBits;
+    int markedCount = 0;
+    unsigned version = 0;      // bumped on every change
+    unsigned savedVersion = 0; // version last written to or read from disk
+    bool registryReadOnly = false; // set while loader threads share the registry
+    bool unresolvedName = false;
+    string loadError; // why the last legacy file failed to load
+    
+    // Lazy loading: a session loaded by header only keeps its cached
+    // summary counts and faults the roster and marks in from its record
+    // in the session store
+    bool resident = true;
+    bool unreadable = false; // the last fault-in could not read the record
+    SessionStore* store = nullptr;
+    int storeSlot = -1;
+    int cachedPresent = 0;
+    int cachedAbsent = 0;
+    int cachedLate = 0;
+    list<size_t>::iterator lruEntry; // in residentSessions while onLruList
+    bool onLruList = false;
+    int historyColumn = -1; // column in the registry's history, once built
+    
+    vector<uint64_t>& plane(AttendanceStatus status) {
+        switch(status) {
+            case PRESENT: return presentBits;
+            case LATE: return lateBits;
+            default: return absentBits;
+        }
+    }
+    
+    static bool testBit(const vector<uint64_t>& bits, uint32_t id) {
+        size_t word = id / 64;
+        return word < bits.size() && ((bits[word] >> (id % 64)) & 1);
+    }
+    
+    // Look up or intern an index number. While the registry is shared by
+    // several loader threads it is only read; an unknown index number then
+    // fails the load so it can be retried on the main thread.
+    bool resolveId(StudentRegistry& allStudents, string_view index, uint32_t& id) {
+        if(!registryReadOnly) {
+            id = allStudents.intern(index);
+            return true;
+        }
+        int32_t found = allStudents.findId(index);
+        if(found == StudentRegistry::NO_ID) {
+            unresolvedName = true;
+            return false;
+        }
+        id = static_cast<uint32_t>(found);
+        return true;
+    }
+    
+    // Take a roster read from a file: shared through the registry when it
+    // may be changed, else private to this session
+    void setLoadedRoster(StudentRegistry& allStudents, vector<uint32_t> ids) {
+        if(registryReadOnly) {
+            auto own = make_shared<RosterSnapshot>();
+            own->ids = move(ids);
+            roster = own;
+        } else {
+            roster = allStudents.shareRoster(move(ids));
+        }
+    }
+    
+    // Store a mark without touching the running totals (used when loading)
+    void setMark(uint32_t id, AttendanceStatus status) {
+        size_t word = id / 64;
+        uint64_t bit = 1ULL << (id % 64);
+        if(word >= presentBits.size()) {
+            presentBits.resize(word + 1, 0);
+            absentBits.resize(word + 1, 0);
+            lateBits.resize(word + 1, 0);
+        }
+        if(!((presentBits[word] | absentBits[word] | lateBits[word]) & bit)) markedCount++;
+        presentBits[word] &= ~bit;
+        absentBits[word] &= ~bit;
+        lateBits[word] &= ~bit;
+        plane(status)[word] |= bit;
+        version++;
+    }
+    
+public:
+    AttendanceSession() {}
+    
+    AttendanceSession(string code, string d, string time, string dur) {
+        courseCode = code;
+        date = d;
+        startTime = time;
+        duration = dur;
+    }
+    
+    // Getters
+    string getCourseCode() const { return courseCode; }
+    string getDate() const { return date; }
+    string getStartTime() const { return startTime; }
+    string getDuration() const { return duration; }
+    // The roster and marks are only in memory while the session is
+    // resident; callers fault them in with ensureResident() first
+    const vector<uint32_t>& getRosterIds() const {
+        static const vector<uint32_t> noStudents;
+        return roster != nullptr ? roster->ids : noStudents;
+    }
+    
+    // Roster version shared with other sessions, 0 if the roster is private
+    uint32_t getRosterVersion() const { return roster != nullptr ? roster->version : 0; }
+    
+    // Share a private roster (e.g. one loaded by a worker thread) through
+    // the registry
+    void shareRoster() {
+        if(roster != nullptr && roster->version == 0 && registry != nullptr) {
+            roster = registry->shareRoster(roster->ids);
+        }
+    }
+    
+    vector<string> getStudentIndices() const {
+        vector<string> indices;
+        indices.reserve(getRosterIds().size());
+        for(uint32_t id : getRosterIds()) {
+            indices.push_back((*registry)[id].getIndexNumber());
+        }
+        return indices;
+    }
+    
+    // Setters
+    void setCourseCode(string code) { courseCode = code; version++; }
+    void setDate(string d) { date = d; version++; }
+    void setStartTime(string time) { startTime = time; version++; }
+    void setDuration(string dur) { duration = dur; version++; }
+    
+    unsigned getVersion() const { return version; }
+    unsigned getSavedVersion() const { return savedVersion; }
+    bool isDirty() const { return version != savedVersion; }
+    
+    // A snapshot of version storedVersion was written to target at slot by
+    // the background writer; later changes keep the session dirty
+    void markStored(SessionStore& target, int slot, unsigned storedVersion) {
+        if(storedVersion <= savedVersion) return;
+        store = &target;
+        storeSlot = slot;
+        savedVersion = storedVersion;
+    }
+    
+    // Roster every registered student, sharing the registry's snapshot
+    void addAllStudents(StudentRegistry& allStudents) {
+        registry = &allStudents;
+        if(allStudents.countsActive()) {
+            for(uint32_t id : getRosterIds()) allStudents.countsFor(id).enrolled--;
+        }
+        roster = allStudents.currentRoster();
+        version++;
+        if(allStudents.countsActive()) {
+            for(uint32_t id : roster->ids) allStudents.countsFor(id).enrolled++;
+        }
+    }
+    
+    // Set or change a mark, keeping the student's running totals in step.
+    // False if the session's record could not be read to apply it to.
+    bool markAttendance(uint32_t id, AttendanceStatus status) {
+        if(!ensureResident()) return false;
+        if(registry != nullptr && registry->countsActive()) {
+            AttendanceCounts& c = registry->countsFor(id);
+            if(isMarked(id)) countStatus(c, getAttendanceStatus(id), -1);
+            countStatus(c, status, +1);
+        }
+        if(registry != nullptr && registry->history().active()) {
+            if(historyColumn >= 0) registry->history().record(static_cast<uint32_t>(historyColumn), id, status);
+            else registry->history().reset();
+        }
+        setMark(id, status);
+        return true;
+    }
+    
+    static void countStatus(AttendanceCounts& c, AttendanceStatus status, int delta) {
+        switch(status) {
+            case PRESENT: c.present += delta; break;
+            case LATE: c.late += delta; break;
+            default: c.absent += delta; break;
+        }
+    }
+    
+    int getHistoryColumn() const { return historyColumn; }
+    void setHistoryColumn(int column) { historyColumn = column; }
+    
+    // Record this session's marks in the registry's history
+    void addToHistory(StudentRegistry& allStudents) const {
+        if(historyColumn < 0) return;
+        for(uint32_t id = 0; id < presentBits.size() * 64 && id < allStudents.idCount(); id++) {
+            if(isMarked(id)) allStudents.history().record(static_cast<uint32_t>(historyColumn), id, getAttendanceStatus(id));
+        }
+    }
+    
+    // Add this session's roster and marks to the registry's totals
+    void addToCounts(StudentRegistry& allStudents) const {
+        for(uint32_t id : getRosterIds()) {
+            allStudents.countsFor(id).enrolled++;
+        }
+        for(uint32_t id = 0; id < presentBits.size() * 64 && id < allStudents.idCount(); id++) {
+            if(isMarked(id)) countStatus(allStudents.countsFor(id), getAttendanceStatus(id), +1);
+        }
+    }
+    
+    bool markAttendance(string index, AttendanceStatus status) {
+        return markAttendance(registry->intern(index), status);
+    }
+    
+    bool isMarked(uint32_t id) const {
+        return testBit(presentBits, id) || testBit(absentBits, id) || testBit(lateBits, id);
+    }
+    
+    AttendanceStatus getAttendanceStatus(uint32_t id) const {
+        if(testBit(presentBits, id)) return PRESENT;
+        if(testBit(lateBits, id)) return LATE;
+        return ABSENT;
+    }
+    
+    AttendanceStatus getAttendanceStatus(string index) const {
+        int32_t id = registry->findId(index);
+        if(id == StudentRegistry::NO_ID) return ABSENT;
+        return getAttendanceStatus(static_cast<uint32_t>(id));
+    }
+    
+    bool isAttendanceMarked() const {
+        return markedCount > 0;
+    }
+    
+    void getSummary(int &present, int &absent, int &late) const {
+        if(!resident) {
+            present = cachedPresent;
+            absent = cachedAbsent;
+            late = cachedLate;
+            return;
+        }
+        present = static_cast<int>(popcountWords(presentBits));
+        absent = static_cast<int>(popcountWords(absentBits));
+        late = static_cast<int>(popcountWords(lateBits));
+    }
+    
+    void display() const {
+        cout << "Course: " << courseCode << " | Date: " << date 
+             << " | Time: " << startTime << " | Duration: " << duration << "hrs\n";
+        if(isAttendanceMarked()) {
+            int p, a, l;
+            getSummary(p, a, l);
+            cout << "Attendance: P:" << p << " A:" << a << " L:" << l << "\n";
+        } else {
+            cout << "Attendance: Not marked yet\n";
+        }
+    }
+    
+    // Identifies the session in the attendance journal
+    string getKey() const {
+        return courseCode + "\t" + date + "\t" + startTime;
+    }
+    
+    // Human-readable form of the key the session is stored under
+    string getRecordName() const {
+        return courseCode + " " + date + " " + startTime;
+    }
+    
+    // Save session to the session store, adding what was written to stats
+    // if given. The store must be synced to make the write durable.
+    bool saveToStore(SessionStore& target, SaveStats* stats = nullptr) {
+        if(!ensureResident()) {
+            return false;
+        }
+        string buffer;
+        encodeBinary(buffer);
+        int slot = target.writeRecord(buffer, courseCode, date, startTime, duration, version, stats);
+        if(slot < 0) {
+            return false;
+        }
+        store = &target;
+        storeSlot = slot;
+        savedVersion = version;
+        return true;
+    }
+    
+    // Serialize into the binary session format. A shared roster is
+    // written as its version number only.
+    void encodeBinary(string& buffer) const {
+        const vector<uint32_t>& rosterIds = getRosterIds();
+        uint32_t rosterVersion = getRosterVersion();
+        
+        // Number the members: the roster first (each student once when
+        // it is stored inline), then marked students outside it
+        vector<int32_t> memberOf(registry != nullptr ? registry->idCount() : 0, -1);
+        vector<uint32_t> members;
+        members.reserve(rosterIds.size());
+        for(uint32_t id : rosterIds) {
+            if(memberOf[id] == -1) {
+                memberOf[id] = static_cast<int32_t>(members.size());
+            } else if(rosterVersion == 0) {
+                continue;
+            }
+            members.push_back(id);
+        }
+        size_t firstName = rosterVersion != 0 ? members.size() : 0;
+        for(uint32_t id = 0; id < presentBits.size() * 64 && id < memberOf.size(); id++) {
+            if(memberOf[id] == -1 && isMarked(id)) {
+                memberOf[id] = static_cast<int32_t>(members.size());
+                members.push_back(id);
+            }
+        }
+        size_t inlineRoster = rosterVersion != 0 ? 0 : rosterIds.size();
+        
+        SessionFileHeader header;
+        memcpy(header.magic, SESSION_MAGIC, 4);
+        header.formatVersion = SESSION_FORMAT_VERSION;
+        header.nameCount = static_cast<uint32_t>(members.size() - firstName);
+        header.rosterCount = static_cast<uint32_t>(rosterIds.size());
+        header.planeWords = static_cast<uint32_t>((members.size() + 63) / 64);
+        header.courseLength = static_cast<uint16_t>(courseCode.size());
+        header.dateLength = static_cast<uint16_t>(date.size());
+        header.timeLength = static_cast<uint16_t>(startTime.size());
+        header.durationLength = static_cast<uint16_t>(duration.size());
+        header.rosterVersion = rosterVersion;
+        header.checksum = 0;
+        int p, a, l;
+        getSummary(p, a, l);
+        header.presentCount = static_cast<uint32_t>(p);
+        header.absentCount = static_cast<uint32_t>(a);
+        header.lateCount = static_cast<uint32_t>(l);
+        header.markedCount = static_cast<uint32_t>(markedCount);
+        
+        string text = courseCode + date + startTime + duration;
+        size_t namesStart = text.size();
+        vector<uint32_t> offsets;
+        offsets.reserve(header.nameCount + 1);
+        for(size_t n = firstName; n < members.size(); n++) {
+            offsets.push_back(static_cast<uint32_t>(text.size() - namesStart));
+            text += (*registry)[members[n]].getIndexNumber();
+        }
+        offsets.push_back(static_cast<uint32_t>(text.size() - namesStart));
+        header.textBytes = static_cast<uint32_t>(text.size());
+        
+        size_t rosterOffset = alignTo8(sizeof(header) + offsets.size() * sizeof(uint32_t) + text.size());
+        size_t planesOffset = alignTo8(rosterOffset + inlineRoster * sizeof(uint32_t));
+        buffer.assign(planesOffset + 3 * header.planeWords * sizeof(uint64_t), '\0');
+        
+        char* out = &buffer[0];
+        memcpy(out, &header, sizeof(header));
+        memcpy(out + sizeof(header), offsets.data(), offsets.size() * sizeof(uint32_t));
+        memcpy(out + sizeof(header) + offsets.size() * sizeof(uint32_t), text.data(), text.size());
+        
+        uint32_t* roster = reinterpret_cast<uint32_t*>(out + rosterOffset);
+        for(size_t i = 0; i < inlineRoster; i++) {
+            roster[i] = static_cast<uint32_t>(memberOf[rosterIds[i]]);
+        }
+        
+        uint64_t* planes = reinterpret_cast<uint64_t*>(out + planesOffset);
+        for(size_t n = 0; n < members.size(); n++) {
+            uint32_t id = members[n];
+            if(!isMarked(id) || memberOf[id] != static_cast<int32_t>(n)) continue;
+            size_t planeIndex = getAttendanceStatus(id) == PRESENT ? 0 : (getAttendanceStatus(id) == ABSENT ? 1 : 2);
+            planes[planeIndex * header.planeWords + n / 64] |= 1ULL << (n % 64);
+        }
+        header.checksum = sessionRecordChecksum(buffer.data(), buffer.size());
+        memcpy(out + offsetof(SessionFileHeader, checksum), &header.checksum, sizeof(header.checksum));
+    }
+    
+    // Load a session from a per-session file written by older versions,
+    // binary (.bin) or text (.txt). With sharedRegistry the registry is
+    // only read, so several threads can load at once; a file naming an
+    // unknown student then fails with needsSerialLoad() set.
+    bool loadFromFile(const string& filename, StudentRegistry& allStudents, bool sharedRegistry = false) {
+        STAT_ADD(STAT_FILES_READ, 1);
+        registryReadOnly = sharedRegistry;
+        unresolvedName = false;
+        loadError.clear();
+        bool ok;
+        if(filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".txt") == 0) {
+            ok = loadFromTextFile(filename, allStudents);
+        } else {
+            ok = loadFromBinaryFile(filename, allStudents);
+            if(!ok && loadError.empty()) loadError = "not a readable session file";
+        }
+        if(!ok && !unresolvedName) STAT_ADD(STAT_PARSE_ERRORS, 1);
+        registryReadOnly = false;
+        return ok;
+    }
+    
+    bool needsSerialLoad() const { return unresolvedName; }
+    const string& getLoadError() const { return loadError; }
+    
+    // Set up the session from its store index entry only: course, date,
+    // time, duration and the cached summary counts. The roster and marks
+    // are read by ensureResident() when first needed.
+    void loadHeaderFromStore(SessionStore& source, int slot, StudentRegistry& allStudents) {
+        const StoreIndexEntry& e = source.entry(slot);
+        courseCode = source.entryCourseCode(slot);
+        date = source.entryDate(slot);
+        startTime = source.entryStartTime(slot);
+        duration = source.entryDuration(slot);
+        cachedPresent = static_cast<int>(e.presentCount);
+        cachedAbsent = static_cast<int>(e.absentCount);
+        cachedLate = static_cast<int>(e.lateCount);
+        markedCount = static_cast<int>(e.markedCount);
+        registry = &allStudents;
+        store = &source;
+        storeSlot = slot;
+        resident = false;
+        savedVersion = version;
+    }
+    
+    bool isResident() const { return resident; }
+    bool isUnreadable() const { return unreadable; }
+    // Place in the resident-session LRU list kept by touchSession
+    bool isOnLruList() const { return onLruList; }
+    list<size_t>::iterator getLruEntry() const { return lruEntry; }
+    void setLruEntry(list<size_t>::iterator entry) {
+        lruEntry = entry;
+        onLruList = true;
+    }
+    void clearLruEntry() { onLruList = false; }
+    
+    // Fault the roster and marks in if only the header is loaded
+    bool ensureResident() {
+        if(resident) return true;
+        STAT_SCOPE(TIMER_FAULT_IN);
+        string buffer;
+        return makeResident(store->readRecord(storeSlot, buffer) ? &buffer : nullptr);
+    }
+    
+    // Store slot of a session loaded from or saved to the store, else -1
+    int getStoreSlot() const { return storeSlot; }
+    
+    // Fault in from a record already read from the store (nullptr if the
+    // read failed), e.g. by a batched read of many sessions
+    bool makeResident(const string* record) {
+        if(resident) return true;
+        resident = true;
+        markedCount = 0;
+        string code = courseCode, d = date, time = startTime, dur = duration;
+        unsigned headerVersion = version;
+        bool ok = record != nullptr && decodeBinary(record->data(), record->size(), *registry);
+        courseCode = code;
+        date = d;
+        startTime = time;
+        duration = dur;
+        if(!ok) {
+            // Drop whatever a partial decode left and keep showing the
+            // cached header rather than an empty session
+            roster.reset();
+            vector<uint64_t>().swap(presentBits);
+            vector<uint64_t>().swap(absentBits);
+            vector<uint64_t>().swap(lateBits);
+            version = headerVersion;
+            resident = false;
+            unreadable = true;
+            markedCount = cachedPresent + cachedAbsent + cachedLate;
+            return false;
+        }
+        unreadable = false;
+        return true;
+    }
+    
+    // Drop the roster and marks of a clean session, keeping its header
+    // and summary counts. Returns false if the session cannot be evicted.
+    bool evict() {
+        if(!resident || isDirty() || storeSlot < 0) return false;
+        getSummary(cachedPresent, cachedAbsent, cachedLate);
+        roster.reset();
+        vector<uint64_t>().swap(presentBits);
+        vector<uint64_t>().swap(absentBits);
+        vector<uint64_t>().swap(lateBits);
+        resident = false;
+        return true;
+    }
+    
+    // Map the file and decode it in place: the only allocations are the
+    // roster and bitplanes themselves and one name-to-ID table
+    bool loadFromBinaryFile(const string& filename, StudentRegistry& allStudents) {
+        int fd = open(filename.c_str(), O_RDONLY);
+        if(fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if(fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(SessionFileHeader))) {
+            close(fd);
+            return false;
+        }
+        size_t size = static_cast<size_t>(info.st_size);
+        STAT_ADD(STAT_BYTES_READ, size);
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if(mapped == MAP_FAILED) {
+            return false;
+        }
+        bool ok = decodeBinary(static_cast<const char*>(mapped), size, allStudents);
+        munmap(mapped, size);
+        return ok;
+    }
+    
+    bool decodeBinary(const char* data, size_t size, StudentRegistry& allStudents) {
+        SessionFileHeader header;
+        if(size < SESSION_HEADER_V1_SIZE) {
+            return false;
+        }
+        memcpy(&header, data, SESSION_HEADER_V1_SIZE);
+        if(memcmp(header.magic, SESSION_MAGIC, 4) != 0) {
+            return false;
+        }
+        size_t headerSize = sizeof(header);
+        if(header.formatVersion == 1) {
+            headerSize = SESSION_HEADER_V1_SIZE;
+            header.rosterVersion = 0;
+        } else if(header.formatVersion < 2 || header.formatVersion > SESSION_FORMAT_VERSION || size < sizeof(header)) {
+            return false;
+        } else {
+            memcpy(&header, data, sizeof(header));
+        }
+        if(header.formatVersion >= 3 && sessionRecordChecksum(data, size) != header.checksum) {
+            loadError = "checksum mismatch";
+            return false;
+        }
+        
+        // A shared roster comes from the registry and is not in the record
+        shared_ptr<const RosterSnapshot> shared;
+        if(header.rosterVersion != 0) {
+            shared = allStudents.rosterVersion(header.rosterVersion);
+            if(shared == nullptr || shared->ids.size() != header.rosterCount) {
+                loadError = "unknown roster version " + to_string(header.rosterVersion);
+                return false;
+            }
+        }
+        size_t rosterMembers = shared != nullptr ? shared->ids.size() : 0;
+        size_t inlineRoster = shared != nullptr ? 0 : header.rosterCount;
+        size_t memberCount = rosterMembers + header.nameCount;
+        
+        size_t offsetsStart = headerSize;
+        size_t textStart = offsetsStart + (static_cast<size_t>(header.nameCount) + 1) * sizeof(uint32_t);
+        size_t rosterOffset = alignTo8(textStart + header.textBytes);
+        size_t planesOffset = alignTo8(rosterOffset + inlineRoster * sizeof(uint32_t));
+        size_t headerTextBytes = static_cast<size_t>(header.courseLength) + header.dateLength
+                               + header.timeLength + header.durationLength;
+        if(planesOffset + 3 * static_cast<size_t>(header.planeWords) * sizeof(uint64_t) > size
+           || headerTextBytes > header.textBytes
+           || header.planeWords < (memberCount + 63) / 64) {
+            return false;
+        }
+        
+        const uint32_t* offsets = reinterpret_cast<const uint32_t*>(data + offsetsStart);
+        const char* text = data + textStart;
+        courseCode.assign(text, header.courseLength);
+        text += header.courseLength;
+        date.assign(text, header.dateLength);
+        text += header.dateLength;
+        startTime.assign(text, header.timeLength);
+        text += header.timeLength;
+        duration.assign(text, header.durationLength);
+        text += header.durationLength;
+        size_t namesBytes = header.textBytes - headerTextBytes;
+        
+        registry = &allStudents;
+        vector<uint32_t> idOf(memberCount);
+        if(shared != nullptr) {
+            copy(shared->ids.begin(), shared->ids.end(), idOf.begin());
+        }
+        for(uint32_t n = 0; n < header.nameCount; n++) {
+            if(offsets[n] > offsets[n + 1] || offsets[n + 1] > namesBytes) {
+                return false;
+            }
+            if(!resolveId(allStudents, string_view(text + offsets[n], offsets[n + 1] - offsets[n]), idOf[rosterMembers + n])) {
+                return false;
+            }
+        }
+        
+        if(shared != nullptr) {
+            roster = shared;
+        } else {
+            const uint32_t* inlineIds = reinterpret_cast<const uint32_t*>(data + rosterOffset);
+            vector<uint32_t> ids(header.rosterCount);
+            for(uint32_t i = 0; i < header.rosterCount; i++) {
+                if(inlineIds[i] >= header.nameCount) {
+                    return false;
+                }
+                ids[i] = idOf[inlineIds[i]];
+            }
+            setLoadedRoster(allStudents, move(ids));
+        }
+        
+        const uint64_t* planes = reinterpret_cast<const uint64_t*>(data + planesOffset);
+        const AttendanceStatus planeStatus[3] = { PRESENT, ABSENT, LATE };
+        for(int plane = 0; plane < 3; plane++) {
+            const uint64_t* words = planes + static_cast<size_t>(plane) * header.planeWords;
+            for(uint32_t w = 0; w < header.planeWords; w++) {
+                uint64_t bits = words[w];
+                while(bits != 0) {
+                    uint32_t n = w * 64 + static_cast<uint32_t>(__builtin_ctzll(bits));
+                    bits &= bits - 1;
+                    if(n < memberCount) {
+                        setMark(idOf[n], planeStatus[plane]);
+                    }
+                }
+            }
+        }
+        
+        savedVersion = version;
+        return true;
+    }
+    
+    // Load session from a text file written by older versions
+    bool loadFromTextFile(const string& filename, StudentRegistry& allStudents) {
+        string text;
+        if(!readWholeFile(filename, text)) {
+            loadError = "could not read the file";
+            return false;
+        }
+        STAT_ADD(STAT_BYTES_READ, text.size());
+        registry = &allStudents;
+        
+        LineReader reader(text);
+        auto fail = [&](const string& message) {
+            loadError = "line " + to_string(reader.lineNumber()) + ": " + message;
+            return false;
+        };
+        
+        string_view line;
+        int attendanceCount = 0;
+        vector<uint32_t> rosterIds;
+        while(reader.next(line)) {
+            size_t colonPos = line.find(':');
+            if(colonPos == string_view::npos) continue;
+            
+            string_view header = line.substr(0, colonPos);
+            string_view value = line.substr(colonPos + 1);
+            
+            if(header == "COURSE") {
+                courseCode = string(value);
+            } else if(header == "DATE") {
+                date = string(value);
+            } else if(header == "TIME") {
+                startTime = string(value);
+            } else if(header == "DURATION") {
+                duration = string(value);
+            } else if(header == "STUDENTS") {
+                int studentCount;
+                if(!parseNumber(value, studentCount) || studentCount < 0) {
+                    return fail("bad student count '" + string(value) + "'");
+                }
+                rosterIds.reserve(studentCount);
+            } else if(header == "INDEX") {
+                uint32_t id;
+                if(!resolveId(allStudents, value, id)) return fail("unknown student " + string(value));
+                rosterIds.push_back(id);
+            } else if(header == "ATTENDANCE") {
+                if(!parseNumber(value, attendanceCount) || attendanceCount < 0) {
+                    return fail("bad attendance count '" + string(value) + "'");
+                }
+            } else if(attendanceCount > 0) {
+                // This is an attendance record
+                int statusInt;
+                if(!parseNumber(value, statusInt) || statusInt < PRESENT || statusInt > LATE) {
+                    return fail("bad status '" + string(value) + "' for " + string(header));
+                }
+                uint32_t id;
+                if(!resolveId(allStudents, header, id)) return fail("unknown student " + string(header));
+                setMark(id, static_cast<AttendanceStatus>(statusInt));
+                attendanceCount--;
+            }
+        }
+        setLoadedRoster(allStudents, move(rosterIds));
+        
+        savedVersion = version;
+        return true;
+    }
+};
+
+// One attendance mark as recorded in the journal
+struct JournalEntry {
+    string sessionKey; // AttendanceSession::getKey()
+    string index;
+    AttendanceStatus status;
+    long long timestamp;
+};
+
+// AttendanceJournal Class - append-only log of attendance marks.
+// Each record is one line: key, index, status and timestamp separated by
+// tabs, followed by the CRC-32 of those fields in hex. A batch of marks is
+// written with a single write and made durable with a single fsync.
+class AttendanceJournal {
+private:
+    string filename;
+    bool holdsUnapplied = false; // replay left marks it could not apply
+    
+public:
+    AttendanceJournal(string file) {
+        filename = file;
+    }
+    
+    string getFilename() const { return filename; }
+    
+    // Append a batch of marks (group commit)
+    bool append(const vector<JournalEntry>& entries) {
+        if(entries.empty()) return true;
+        
+        string buffer;
+        for(const auto& entry : entries) {
+            string payload = entry.sessionKey + "\t" + entry.index + "\t"
+                           + to_string(static_cast<int>(entry.status)) + "\t"
+                           + to_string(entry.timestamp);
+            char crcText[9];
+            snprintf(crcText, sizeof(crcText), "%08x", crc32(payload.data(), payload.size()));
+            buffer += payload + "\t" + crcText + "\n";
+        }
+        
+        // A journal created here is only durable once its directory entry is
+        bool created = false;
+        int fd = open(filename.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+        if(fd < 0 && errno == ENOENT) {
+            fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+            created = true;
+        }
+        if(fd < 0) return false;
+        STAT_ADD(STAT_FILES_WRITTEN, 1);
+        STAT_ADD(STAT_BYTES_WRITTEN, buffer.size());
+        
+        bool ok = writeFully(fd, buffer.data(), buffer.size()) && fsync(fd) == 0;
+        close(fd);
+        if(ok && created) {
+            ok = syncDirectory(parentDirectory(filename));
+        }
+        return ok;
+    }
+    
+    // Read back every intact record in order. Stops at the first record
+    // that fails its checksum (a torn write from a crash) and returns the
+    // number of records delivered; badRecords is set to the lines skipped
+    // and validBytes to the length of the intact prefix.
+    int replay(const function<void(const JournalEntry&)>& apply, int& badRecords, size_t& validBytes) const {
+        badRecords = 0;
+        validBytes = 0;
+        string text;
+        if(!readWholeFile(filename, text)) return 0;
+        STAT_ADD(STAT_FILES_READ, 1);
+        STAT_ADD(STAT_BYTES_READ, text.size());
+        
+        int applied = 0;
+        LineReader reader(text);
+        string_view line;
+        while(reader.next(line)) {
+            size_t crcPos = line.rfind('\t');
+            if(crcPos == string_view::npos) {
+                badRecords++;
+                break;
+            }
+            string_view payload = line.substr(0, crcPos);
+            char crcText[9];
+            snprintf(crcText, sizeof(crcText), "%08x", crc32(payload.data(), payload.size()));
+            if(line.substr(crcPos + 1) != crcText) {
+                badRecords++;
+                break;
+            }
+            
+            string_view fields[6];
+            int status;
+            JournalEntry entry;
+            if(splitFields(payload, '\t', fields, 6) != 6 || !parseNumber(fields[4], status)
+               || status < PRESENT || status > LATE || !parseNumber(fields[5], entry.timestamp)) {
+                badRecords++;
+                break;
+            }
+            
+            entry.sessionKey = string(payload.substr(0, fields[3].data() - payload.data() - 1));
+            entry.index = string(fields[3]);
+            entry.status = static_cast<AttendanceStatus>(status);
+            apply(entry);
+            applied++;
+            validBytes = reader.offset();
+        }
+        
+        // Count whatever follows a bad record as lost
+        while(badRecords > 0 && reader.next(line)) badRecords++;
+        STAT_ADD(STAT_PARSE_ERRORS, badRecords);
+        return applied;
+    }
+    
+    size_t sizeOnDisk() const {
+        error_code ec;
+        uintmax_t size = fs::file_size(filename, ec);
+        return ec ? 0 : static_cast<size_t>(size);
+    }
+    
+    // Drop a damaged tail so new records are not appended after it
+    bool truncateTo(size_t length) {
+        return truncate(filename.c_str(), static_cast<off_t>(length)) == 0;
+    }
+    
+    // Marks replay could not apply (their session's record is unreadable)
+    // are only in the journal, so it is no longer reset
+    void keepUnapplied() { holdsUnapplied = true; }
+    
+    // Called once every journaled mark is in a durable session snapshot
+    bool reset() {
+        if(holdsUnapplied) return true;
+        int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0) return false;
+        bool ok = fsync(fd) == 0;
+        close(fd);
+        return ok;
+    }
+};
+
+// JournalCompactor Class - background thread that folds the journal into
+// session snapshots once it grows past a threshold, or after a quiet period
+// when it holds any records. The actual folding is done by the callback.
+class JournalCompactor {
+private:
+    const AttendanceJournal& journal;
+    function<void()> compact;
+    size_t thresholdBytes;
+    thread worker;
+    mutex wakeMutex;
+    condition_variable wake;
+    bool stopping = false;
+    
+    void run() {
+        unique_lock<mutex> lock(wakeMutex);
+        while(!stopping) {
+            wake.wait_for(lock, chrono::seconds(30));
+            if(stopping) break;
+            size_t size = journal.sizeOnDisk();
+            if(size == 0) continue;
+            lock.unlock();
+            compact();
+            lock.lock();
+        }
+    }
+    
+public:
+    JournalCompactor(const AttendanceJournal& j, function<void()> compactFn, size_t threshold)
+        : journal(j), compact(compactFn), thresholdBytes(threshold) {}
+    
+    ~JournalCompactor() {
+        stop();
+    }
+    
+    void start() {
+        stopping = false;
+        worker = thread(&JournalCompactor::run, this);
+    }
+    
+    // Called after each committed batch; wakes the thread once the journal
+    // is past the threshold
+    void notifyCommitted() {
+        if(journal.sizeOnDisk() >= thresholdBytes) {
+            wake.notify_one();
+        }
+    }
+    
+    void stop() {
+        {
+            lock_guard<mutex> lock(wakeMutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        if(worker.joinable()) worker.join();
+    }
+};
+
+// Immutable unit of work for the background writer: new students.txt
+// rows, the encoded record of one session version, or a batch of marks
+// for the journal
+struct PersistSnapshot {
+    enum Kind { STUDENT_ROWS, SESSION_RECORD, JOURNAL_BATCH };
+    Kind kind;
+    string data; // CSV rows, or the encoded session record
+    string courseCode, date, startTime, duration;
+    unsigned version = 0;
+    vector<JournalEntry> marks;
+    
+    string sessionKey() const { return SessionStore::makeKey(courseCode, date, startTime); }
+};
+
+// Everything accepted but not yet durable, coalesced: rows and marks in
+// order, and only the newest record of each session
+struct PendingWrites {
+    string studentRows;
+    map<string, shared_ptr<const PersistSnapshot>> sessionRecords;
+    vector<JournalEntry> marks;
+    
+    bool empty() const { return studentRows.empty() && sessionRecords.empty() && marks.empty(); }
+    
+    void add(const shared_ptr<const PersistSnapshot>& snapshot) {
+        switch(snapshot->kind) {
+            case PersistSnapshot::STUDENT_ROWS:
+                studentRows += snapshot->data;
+                break;
+            case PersistSnapshot::SESSION_RECORD: {
+                auto& newest = sessionRecords[snapshot->sessionKey()];
+                if(newest == nullptr || newest->version < snapshot->version) newest = snapshot;
+                break;
+            }
+            case PersistSnapshot::JOURNAL_BATCH:
+                marks.insert(marks.end(), snapshot->marks.begin(), snapshot->marks.end());
+                break;
+        }
+    }
+};
+
+// BackgroundWriter Class - a thread that makes snapshots durable so the
+// caller never waits on the disk. submit() only blocks when the bounded
+// queue is full. Each round takes everything queued, coalesces it with
+// whatever an earlier round could not write, and hands it to the write
+// function, which removes what it made durable. flush() waits for the
+// queue to drain and retries leftovers once.
+class BackgroundWriter {
+private:
+    function<bool(PendingWrites&)> write;
+    size_t capacity;
+    deque<shared_ptr<const PersistSnapshot>> queue;
+    PendingWrites pending; // worker thread only
+    thread worker;
+    mutex queueMutex;
+    condition_variable wake;    // work, a retry or stop for the worker
+    condition_variable changed; // queue space or a finished round
+    bool stopping = false;
+    bool busy = false;
+    bool retry = false;
+    bool leftover = false;      // the last round could not write everything
+    size_t rounds = 0;
+    size_t coalesced = 0;       // snapshots merged into a queued one
+    
+    void run() {
+        unique_lock<mutex> lock(queueMutex);
+        while(true) {
+            wake.wait(lock, [&]() { return stopping || retry || !queue.empty(); });
+            if(stopping && queue.empty() && !retry) break;
+            deque<shared_ptr<const PersistSnapshot>> batch;
+            batch.swap(queue);
+            retry = false;
+            busy = true;
+            changed.notify_all();
+            lock.unlock();
+            
+            for(const auto& snapshot : batch) {
+                pending.add(snapshot);
+            }
+            bool written = pending.empty() || write(pending);
+            
+            lock.lock();
+            busy = false;
+            leftover = !written || !pending.empty();
+            rounds++;
+            changed.notify_all();
+        }
+    }
+    
+public:
+    BackgroundWriter(function<bool(PendingWrites&)> writeFn, size_t queueCapacity)
+        : write(writeFn), capacity(queueCapacity) {}
+    
+    ~BackgroundWriter() {
+        stop();
+    }
+    
+    // Queue a snapshot, starting the thread on first use. A session record
+    // replaces an older queued record of the same session.
+    void submit(shared_ptr<const PersistSnapshot> snapshot) {
+        unique_lock<mutex> lock(queueMutex);
+        if(!worker.joinable()) {
+            stopping = false;
+            worker = thread(&BackgroundWriter::run, this);
+        }
+        if(snapshot->kind == PersistSnapshot::SESSION_RECORD) {
+            for(auto& queued : queue) {
+                if(queued->kind == PersistSnapshot::SESSION_RECORD && queued->sessionKey() == snapshot->sessionKey()) {
+                    queued = move(snapshot);
+                    coalesced++;
+                    return;
+                }
+            }
+        }
+        changed.wait(lock, [&]() { return queue.size() < capacity; });
+        queue.push_back(move(snapshot));
+        wake.notify_one();
+    }
+    
+    // Wait until everything submitted so far is written; false if some of
+    // it could not be, even after a retry
+    bool flush() {
+        unique_lock<mutex> lock(queueMutex);
+        if(!worker.joinable()) return !leftover;
+        changed.wait(lock, [&]() { return queue.empty() && !busy; });
+        if(leftover) {
+            retry = true;
+            wake.notify_one();
+            changed.wait(lock, [&]() { return queue.empty() && !busy && !retry; });
+        }
+        return !leftover;
+    }
+    
+    // True if the last round left something unwritten
+    bool hasLeftovers() {
+        lock_guard<mutex> lock(queueMutex);
+        return leftover;
+    }
+    
+    void getCounts(size_t& roundCount, size_t& coalescedCount) {
+        lock_guard<mutex> lock(queueMutex);
+        roundCount = rounds;
+        coalescedCount = coalesced;
+    }
+    
+    // Flush, then end the thread
+    bool stop() {
+        bool flushed = flush();
+        {
+            lock_guard<mutex> lock(queueMutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        if(worker.joinable()) worker.join();
+        return flushed;
+    }
+};
+
+// SpscQueue Class - bounded lock-free ring buffer for one producer thread
+// and one consumer thread. Capacity is rounded up to a power of two.
+template <typename T>
+class SpscQueue {
+private:
+    vector<T> buffer;
+    size_t mask;
+    alignas(64) atomic<size_t> head{0}; // next slot to read, owned by the consumer
+    alignas(64) atomic<size_t> tail{0}; // next slot to write, owned by the producer
+    
+public:
+    SpscQueue(size_t capacity) {
+        size_t size = 2;
+        while(size < capacity) size *= 2;
+        buffer.resize(size);
+        mask = size - 1;
+    }
+    
+    bool tryPush(const T& item) {
+        size_t t = tail.load(memory_order_relaxed);
+        if(t - head.load(memory_order_acquire) == buffer.size()) return false;
+        buffer[t & mask] = item;
+        tail.store(t + 1, memory_order_release);
+        return true;
+    }
+    
+    bool tryPop(T& item) {
+        size_t h = head.load(memory_order_relaxed);
+        if(h == tail.load(memory_order_acquire)) return false;
+        item = buffer[h & mask];
+        head.store(h + 1, memory_order_release);
+        return true;
+    }
+};
+
+// SessionIndex Class - sessions ordered by (courseCode, date, startTime),
+// holding their positions in the sessions vector. Supports point lookups,
+// date-range queries for one course and course-code prefix queries, each
+// in O(log n + k).
+class SessionIndex {
+private:
+    typedef tuple<string, string, string> Key;
+    map<Key, size_t> entries;
+    
+public:
+    void clear() { entries.clear(); }
+    size_t size() const { return entries.size(); }
+    
+    void insert(const AttendanceSession& session, size_t position) {
+        entries[Key(session.getCourseCode(), session.getDate(), session.getStartTime())] = position;
+    }
+    
+    // Position of the session, or -1
+    long find(const string& courseCode, const string& date, const string& startTime) const {
+        STAT_ADD(STAT_LOOKUPS, 1);
+        auto it = entries.find(Key(courseCode, date, startTime));
+        return it == entries.end() ? -1 : static_cast<long>(it->second);
+    }
+    
+    // Sessions of courses matching course (exactly, or as a prefix when
+    // prefix is set) dated fromDate..toDate inclusive; empty dates are
+    // open-ended. Results are in (course, date, time) order.
+    vector<size_t> query(const string& course, bool prefix, const string& fromDate, const string& toDate) const {
+        STAT_ADD(STAT_LOOKUPS, 1);
+        vector<size_t> result;
+        auto it = entries.lower_bound(Key(course, fromDate, ""));
+        while(it != entries.end()) {
+            const string& code = get<0>(it->first);
+            if(prefix ? code.compare(0, course.size(), course) != 0 : code != course) break;
+            
+            const string& date = get<1>(it->first);
+            if(!fromDate.empty() && date < fromDate) {
+                // New course under the prefix: skip to the start of the range
+                it = entries.lower_bound(Key(code, fromDate, ""));
+            } else if(!toDate.empty() && date > toDate) {
+                if(!prefix) break;
+                // Past the range: skip to the first key of the next course
+                it = entries.lower_bound(Key(code + '\0', "", ""));
+            } else {
+                result.push_back(it->second);
+                ++it;
+            }
+        }
+        return result;
+    }
+    
+    // Every session in index order
+    vector<size_t> all() const {
+        vector<size_t> result;
+        result.reserve(entries.size());
+        for(const auto& entry : entries) result.push_back(entry.second);
+        return result;
+    }
+};
+
+// ReportWriter Class - renders reports as plain text, CSV or HTML into
+// an output buffer that is written to the terminal or a file in large
+// blocks, so a report of thousands of rows is not flushed line by line.
+// Reports are built from titles, label/value fields, sections and tables.
+enum ReportFormat { REPORT_TEXT, REPORT_CSV, REPORT_HTML };
+
+struct ReportColumn {
+    string heading;
+    int width;          // text format only; 0 = no padding
+    bool alignRight;
+};
+
+class ReportWriter {
+private:
+    ostream* out;
+    ofstream file;
+    ReportFormat format;
+    string buffer;
+    vector<ReportColumn> columns;
+    size_t ruleWidth = 0;
+    size_t bytesWritten = 0;
+    bool finished = false;
+    static const size_t FLUSH_BYTES = 64 * 1024;
+    
+    void flushIfFull() {
+        if(buffer.size() >= FLUSH_BYTES) flush();
+    }
+    
+    void appendEscaped(string_view text) {
+        if(format == REPORT_HTML) {
+            for(char c : text) {
+                switch(c) {
+                    case '&': buffer += "&amp;"; break;
+                    case '<': buffer += "&lt;"; break;
+                    case '>': buffer += "&gt;"; break;
+                    case '"': buffer += "&quot;"; break;
+                    default: buffer += c;
+                }
+            }
+        } else if(format == REPORT_CSV && text.find_first_of(",\"\n") != string_view::npos) {
+            buffer += '"';
+            for(char c : text) {
+                if(c == '"') buffer += '"';
+                buffer += c;
+            }
+            buffer += '"';
+        } else {
+            buffer.append(text);
+        }
+    }
+    
+    void appendPadded(string_view text, int width, bool alignRight) {
+        size_t padding = static_cast<size_t>(width) > text.size() ? width - text.size() : 0;
+        if(alignRight) buffer.append(padding, ' ');
+        buffer.append(text);
+        if(!alignRight) buffer.append(padding, ' ');
+    }
+    
+public:
+    // Report to the terminal
+    explicit ReportWriter(ReportFormat f = REPORT_TEXT) : out(&cout), format(f) {
+        buffer.reserve(FLUSH_BYTES + 4096);
+    }
+    
+    // Report to a file; the format follows the extension (.csv, .html or
+    // .htm, anything else is plain text). Check isOpen() before use.
+    explicit ReportWriter(const string& filename) : out(&file), format(formatForFile(filename)) {
+        file.open(filename, ios::binary | ios::trunc);
+        buffer.reserve(FLUSH_BYTES + 4096);
+        if(format == REPORT_HTML) {
+            buffer += "<!DOCTYPE html>\n<html><head><meta charset=\"utf-8\"><title>Attendance report</title></head><body>\n";
+        }
+    }
+    
+    ~ReportWriter() { finish(); }
+    
+    static ReportFormat formatForFile(const string& filename) {
+        string extension = fs::path(filename).extension().string();
+        for(char& c : extension) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        if(extension == ".csv") return REPORT_CSV;
+        if(extension == ".html" || extension == ".htm") return REPORT_HTML;
+        return REPORT_TEXT;
+    }
+    
+    bool isOpen() const { return out != &file || file.is_open(); }
+    ReportFormat getFormat() const { return format; }
+    size_t getBytesWritten() const { return bytesWritten + buffer.size(); }
+    
+    void title(string_view text) {
+        if(format == REPORT_TEXT) {
+            buffer += "\n========== ";
+            buffer.append(text);
+            buffer += " ==========\n";
+        } else if(format == REPORT_CSV) {
+            appendEscaped(text);
+            buffer += '\n';
+        } else {
+            buffer += "<h1>";
+            appendEscaped(text);
+            buffer += "</h1>\n";
+        }
+    }
+    
+    void field(string_view label, string_view value) {
+        if(format == REPORT_TEXT) {
+            buffer.append(label);
+            buffer += ": ";
+            buffer.append(value);
+            buffer += '\n';
+        } else if(format == REPORT_CSV) {
+            appendEscaped(label);
+            buffer += ',';
+            appendEscaped(value);
+            buffer += '\n';
+        } else {
+            buffer += "<p><b>";
+            appendEscaped(label);
+            buffer += ":</b> ";
+            appendEscaped(value);
+            buffer += "</p>\n";
+        }
+    }
+    
+    void section(string_view name) {
+        if(format == REPORT_TEXT) {
+            buffer += '\n';
+            buffer.append(name);
+            buffer += ":\n";
+        } else if(format == REPORT_CSV) {
+            buffer += '\n';
+            appendEscaped(name);
+            buffer += '\n';
+        } else {
+            buffer += "<h2>";
+            appendEscaped(name);
+            buffer += "</h2>\n";
+        }
+    }
+    
+    // A line of prose; left out of CSV output
+    void note(string_view text) {
+        if(format == REPORT_TEXT) {
+            buffer.append(text);
+            buffer += '\n';
+        } else if(format == REPORT_HTML) {
+            buffer += "<p>";
+            appendEscaped(text);
+            buffer += "</p>\n";
+        }
+    }
+    
+    void beginTable(const vector<ReportColumn>& tableColumns) {
+        columns = tableColumns;
+        if(format == REPORT_TEXT) {
+            ruleWidth = 0;
+            for(const auto& column : columns) {
+                ruleWidth += max<size_t>(column.width, column.heading.size());
+            }
+            ruleWidth = max<size_t>(ruleWidth, 40);
+            buffer.append(ruleWidth, '-');
+            buffer += '\n';
+        } else if(format == REPORT_HTML) {
+            buffer += "<table border=\"1\" cellpadding=\"3\">\n";
+        }
+        vector<string_view> headings;
+        for(const auto& column : columns) headings.push_back(column.heading);
+        row(headings, true);
+        if(format == REPORT_TEXT) {
+            buffer.append(ruleWidth, '-');
+            buffer += '\n';
+        }
+    }
+    
+    void row(const vector<string_view>& cells, bool heading = false) {
+        if(format == REPORT_HTML) buffer += "<tr>";
+        for(size_t i = 0; i < cells.size() && i < columns.size(); i++) {
+            if(format == REPORT_TEXT) {
+                bool last = i + 1 == cells.size();
+                appendPadded(cells[i], last && !columns[i].alignRight ? 0 : columns[i].width, columns[i].alignRight);
+            } else if(format == REPORT_CSV) {
+                if(i > 0) buffer += ',';
+                appendEscaped(cells[i]);
+            } else {
+                buffer += heading ? "<th>" : (columns[i].alignRight ? "<td align=\"right\">" : "<td>");
+                appendEscaped(cells[i]);
+                buffer += heading ? "</th>" : "</td>";
+            }
+        }
+        buffer += format == REPORT_HTML ? "</tr>\n" : "\n";
+        flushIfFull();
+    }
+    
+    void endTable() {
+        if(format == REPORT_TEXT) {
+            buffer.append(ruleWidth, '-');
+            buffer += '\n';
+        } else if(format == REPORT_HTML) {
+            buffer += "</table>\n";
+        }
+        columns.clear();
+    }
+    
+    void flush() {
+        if(!buffer.empty()) {
+            out->write(buffer.data(), static_cast<streamsize>(buffer.size()));
+            STAT_ADD(STAT_BYTES_WRITTEN, buffer.size());
+            bytesWritten += buffer.size();
+            buffer.clear();
+        }
+        out->flush();
+    }
+    
+    // Close the document and write everything out; false on a write error
+    bool finish() {
+        if(finished) return true;
+        finished = true;
+        if(format == REPORT_HTML && out == &file) {
+            buffer += "</body></html>\n";
+        }
+        flush();
+        bool ok = out->good();
+        if(file.is_open()) {
+            STAT_ADD(STAT_FILES_WRITTEN, 1);
+            file.close();
+        }
+        return ok;
+    }
+};
+
+// Report number formatting
+inline string formatPercent(int part, int whole) {
+    char text[16];
+    snprintf(text, sizeof(text), "%.1f%%", whole > 0 ? part * 100.0 / whole : 0.0);
+    return text;
+}
+
+// Global data
+inline StudentRegistry students;
+inline vector<AttendanceSession> sessions;
+inline SessionIndex sessionIndex; // (course, date, time) -> position in sessions
+
+// File paths
+inline const string STUDENT_FILE = "students.txt";
+inline const string JOURNAL_FILE = "attendance.journal";
+inline const string SESSION_DATA_FILE = "sessions.dat";
+inline const string SESSION_INDEX_FILE = "sessions.idx";
+inline const string ROSTER_FILE = "rosters.txt"; // shared roster versions, as deltas
+inline const string STATS_FILE = "attendance_stats.json"; // written on exit and on SIGUSR1
+inline const string LOCK_FILE = "attendance.lock"; // held by the process that owns the data
+
+// Every session's roster and marks, in one data file plus an index
+inline SessionStore sessionStore;
+
+// Journal of attendance marks not yet folded into session files.
+// dataMutex guards students, sessions and the journal against the
+// compactor thread.
+inline AttendanceJournal journal(JOURNAL_FILE);
+inline mutex dataMutex;
+const size_t JOURNAL_COMPACT_BYTES = 256 * 1024;
+
+// At most this many sessions keep their roster and marks in memory; the
+// least recently used clean ones are evicted back to header-only
+const size_t MAX_RESIDENT_SESSIONS = 256;
+
+// Positions of the sessions touchSession made resident, most recently
+// used first; each session holds its own entry, so a touch is a splice
+inline list<size_t> residentSessions;
+
+// Session loader threads; 0 = one per hardware thread
+inline unsigned loadThreads = 0;
+
+// Core functions defined below
+inline bool saveAllData();
+inline SaveStats saveDirtySessions(bool verbose, bool* allSaved = nullptr);
+inline bool loadAllData();
+inline bool saveRosters();
+inline void loadRosters();
+inline void compactJournal();
+inline void migrateSessionFiles();
+inline bool touchSession(AttendanceSession &session);
+inline bool writePendingSnapshots(PendingWrites& pending);
+
+// Background thread folding the journal into session files
+inline JournalCompactor compactor(journal, compactJournal, JOURNAL_COMPACT_BYTES);
+
+// Background thread writing new students, new sessions and marks, so
+// interactive steps do not wait on the disk
+const size_t WRITER_QUEUE_CAPACITY = 64;
+inline BackgroundWriter backgroundWriter(writePendingSnapshots, WRITER_QUEUE_CAPACITY);
+
+// File handling functions
+// Only students registered since the last save are added, and only
+// sessions whose version changed since they were last written are saved.
+// False if anything could not be written. Callers hold dataMutex.
+inline bool saveAllData() {
+    STAT_SCOPE(TIMER_SAVE);
+    SaveStats stats;
+    bool studentsSaved = true;
+    
+    // Add new students. The file is never appended to in place: the old
+    // contents plus the new rows go through a temporary file and a rename,
+    // so a crash leaves either the old list or the new one.
+    const vector<uint32_t>& unsavedIds = students.getUnsavedIds();
+    if(!unsavedIds.empty()) {
+        string buffer;
+        readWholeFile(STUDENT_FILE, buffer);
+        // Make sure the first new record starts on its own line
+        if(!buffer.empty() && buffer.back() != '\n') buffer += '\n';
+        for(uint32_t id : unsavedIds) {
+            buffer += students[id].toCSV();
+            buffer += '\n';
+        }
+        
+        size_t bytes = buffer.size();
+        GroupCommit commit;
+        commit.replace(STUDENT_FILE, move(buffer));
+        if(commit.commit()) {
+            STAT_ADD(STAT_FILES_WRITTEN, 1);
+            STAT_ADD(STAT_BYTES_WRITTEN, bytes);
+            stats.filesWritten++;
+            stats.bytesWritten += bytes;
+            cout << "\n✓ " << unsavedIds.size() << " new student(s) saved to file.\n";
+            students.markSaved();
+        } else {
+            cout << "\n✗ Error: Could not save students to file (" << commit.error() << ").\n";
+            studentsSaved = false;
+        }
+    }
+    
+    // Save changed sessions; the journal is folded into them
+    bool sessionsSaved = true;
+    SaveStats sessionStats = saveDirtySessions(true, &sessionsSaved);
+    stats.filesWritten += sessionStats.filesWritten;
+    stats.bytesWritten += sessionStats.bytesWritten;
+    stats.recordsWritten = sessionStats.recordsWritten;
+    stats.sessionsSkipped = sessionStats.sessionsSkipped;
+    
+    cout << "✓ Save complete: " << stats.filesWritten << " file(s), " << stats.bytesWritten
+         << " bytes written, " << stats.recordsWritten << " session record(s) updated, "
+         << stats.sessionsSkipped << " unchanged session(s) skipped.\n";
+    return studentsSaved && sessionsSaved;
+}
+
+// The encoded records of every changed session, taken under dataMutex so
+// they can be written to the store without it
+struct DirtySessions {
+    vector<size_t> positions;
+    vector<unsigned> versions;
+    vector<string> records;
+    vector<SessionStore::RecordWrite> writes; // point into records
+    vector<int> slots;
+    bool rostersSaved = false;
+    bool saved = true; // false once anything could not be encoded or written
+};
+
+// Encode every changed session. Rosters are saved first, since records
+// name their roster version. Callers hold dataMutex.
+inline void encodeDirtySessions(DirtySessions& dirty, SaveStats& stats, bool verbose) {
+    if(!saveRosters()) {
+        if(verbose) cout << "✗ Error: Could not save " << ROSTER_FILE << "; sessions not saved.\n";
+        dirty.saved = false;
+        return;
+    }
+    dirty.rostersSaved = true;
+    for(size_t i = 0; i < sessions.size(); i++) {
+        AttendanceSession& session = sessions[i];
+        if(!session.isDirty()) {
+            stats.sessionsSkipped++;
+            continue;
+        }
+        if(!session.ensureResident()) {
+            dirty.saved = false;
+            if(verbose) cout << "✗ Error: Could not save session " << session.getRecordName() << endl;
+            continue;
+        }
+        dirty.positions.push_back(i);
+        dirty.versions.push_back(session.getVersion());
+    }
+    dirty.records.resize(dirty.positions.size());
+    dirty.writes.reserve(dirty.positions.size());
+    for(size_t i = 0; i < dirty.positions.size(); i++) {
+        AttendanceSession& session = sessions[dirty.positions[i]];
+        session.encodeBinary(dirty.records[i]);
+        dirty.writes.push_back({&dirty.records[i], session.getCourseCode(), session.getDate(),
+                                session.getStartTime(), session.getDuration(), dirty.versions[i]});
+    }
+}
+
+// Write the encoded records as one batch and sync the store. Needs no
+// dataMutex: the store has its own lock.
+inline void storeDirtySessions(DirtySessions& dirty, SaveStats& stats, bool verbose) {
+    if(!dirty.rostersSaved) return;
+    dirty.slots = sessionStore.writeRecords(dirty.writes, &stats);
+    if(!sessionStore.sync(&stats)) {
+        dirty.saved = false;
+        if(verbose) cout << "✗ Error: Could not sync the session store.\n";
+    }
+}
+
+// Record which sessions are now in the store. Callers hold dataMutex.
+inline void markDirtySessionsStored(DirtySessions& dirty, bool verbose) {
+    for(size_t i = 0; i < dirty.positions.size(); i++) {
+        AttendanceSession& session = sessions[dirty.positions[i]];
+        if(dirty.slots[i] >= 0) {
+            session.markStored(sessionStore, dirty.slots[i], dirty.versions[i]);
+            if(verbose) cout << "✓ Session saved: " << session.getRecordName() << endl;
+        } else {
+            dirty.saved = false;
+            if(verbose) cout << "✗ Error: Could not save session " << session.getRecordName() << endl;
+        }
+    }
+}
+
+// Write every changed session to the store and make it durable with one
+// sync. Once that succeeds the journal holds nothing that is not in the
+// store, so it is reset. allSaved, if given, reports whether it did.
+// Callers hold dataMutex.
+inline SaveStats saveDirtySessions(bool verbose, bool* allSaved) {
+    SaveStats stats;
+    DirtySessions dirty;
+    encodeDirtySessions(dirty, stats, verbose);
+    storeDirtySessions(dirty, stats, verbose);
+    markDirtySessionsStored(dirty, verbose);
+    if(dirty.saved) {
+        journal.reset();
+    }
+    if(allSaved != nullptr) *allSaved = dirty.saved;
+    return stats;
+}
+
+// Add the roster versions made since the last save to rosters.txt,
+// through a temporary file like students.txt. Session records name their
+// roster version, so this runs before any session record is written.
+// Callers hold dataMutex.
+inline bool saveRosters() {
+    if(!students.hasUnsavedRosters()) return true;
+    string buffer;
+    readWholeFile(ROSTER_FILE, buffer);
+    if(!buffer.empty() && buffer.back() != '\n') buffer += '\n';
+    buffer += students.unsavedRosterRows();
+    [[maybe_unused]] size_t bytes = buffer.size();
+    if(!writeFileDurably(ROSTER_FILE, move(buffer))) return false;
+    STAT_ADD(STAT_FILES_WRITTEN, 1);
+    STAT_ADD(STAT_BYTES_WRITTEN, bytes);
+    students.markRostersSaved();
+    return true;
+}
+
+// Read the roster versions back from rosters.txt, each line being
+// VERSION,BASE,INDEX,... Stops at the first line that does not continue
+// the sequence; records naming a later version then fail to load.
+inline void loadRosters() {
+    string text;
+    if(!readWholeFile(ROSTER_FILE, text)) return;
+    STAT_ADD(STAT_FILES_READ, 1);
+    STAT_ADD(STAT_BYTES_READ, text.size());
+    vector<ParseError> errors;
+    LineReader reader(text);
+    string_view line;
+    vector<uint32_t> added;
+    while(reader.next(line)) {
+        if(line.empty()) continue;
+        string_view fields[2];
+        uint32_t version, base;
+        size_t count = splitFields(line, ',', fields, 2);
+        if(count < 2 || !parseNumber(fields[0], version) || !parseNumber(fields[1], base)) {
+            errors.push_back({reader.lineNumber(), "expected VERSION,BASE,INDEX,..."});
+            break;
+        }
+        added.clear();
+        size_t start = fields[1].data() + fields[1].size() - line.data();
+        while(start < line.size()) {
+            size_t comma = line.find(',', start + 1);
+            if(comma == string_view::npos) comma = line.size();
+            added.push_back(students.intern(line.substr(start + 1, comma - start - 1)));
+            start = comma;
+        }
+        if(!students.loadRoster(version, base, added)) {
+            errors.push_back({reader.lineNumber(), "roster version " + to_string(version) + " out of sequence"});
+            break;
+        }
+    }
+    STAT_ADD(STAT_PARSE_ERRORS, errors.size());
+    if(!errors.empty()) {
+        cout << "✗ Warning: stopped reading " << ROSTER_FILE << " at a malformed line:\n";
+        reportParseErrors(cout, ROSTER_FILE, errors);
+    }
+}
+
+// Background writer callback. New students go to students.txt through a
+// temporary file, session records to the store with one sync, and marks
+// to the journal; whatever was made durable is removed from pending. A
+// record older than what the session already has on disk (the compactor
+// may have saved it meanwhile) is dropped rather than written over it.
+inline bool writePendingSnapshots(PendingWrites& pending) {
+    bool written = true;
+    
+    if(!pending.studentRows.empty()) {
+        // Read and extended under dataMutex, like saveAllData does, and
+        // written without it
+        string buffer;
+        {
+            lock_guard<mutex> lock(dataMutex);
+            readWholeFile(STUDENT_FILE, buffer);
+            if(!buffer.empty() && buffer.back() != '\n') buffer += '\n';
+            buffer += pending.studentRows;
+        }
+        [[maybe_unused]] size_t bytes = buffer.size();
+        if(writeFileDurably(STUDENT_FILE, move(buffer))) {
+            STAT_ADD(STAT_FILES_WRITTEN, 1);
+            STAT_ADD(STAT_BYTES_WRITTEN, bytes);
+            pending.studentRows.clear();
+        } else {
+            written = false;
+        }
+    }
+    
+    if(!pending.sessionRecords.empty()) {
+        // As compactJournal does: the records are picked (and any new
+        // roster versions saved) under dataMutex, written and synced
+        // without it, and marked stored under it again. The store skips a
+        // record older than one the compactor wrote meanwhile, and
+        // markStored ignores it.
+        vector<shared_ptr<const PersistSnapshot>> chosen;
+        vector<SessionStore::RecordWrite> writes;
+        {
+            lock_guard<mutex> lock(dataMutex);
+            if(!saveRosters()) return false;
+            for(auto it = pending.sessionRecords.begin(); it != pending.sessionRecords.end();) {
+                const PersistSnapshot& record = *it->second;
+                long position = sessionIndex.find(record.courseCode, record.date, record.startTime);
+                if(position < 0 || sessions[position].getSavedVersion() >= record.version) {
+                    it = pending.sessionRecords.erase(it);
+                    continue;
+                }
+                chosen.push_back(it->second);
+                writes.push_back({&record.data, record.courseCode, record.date, record.startTime,
+                                  record.duration, record.version});
+                ++it;
+            }
+        }
+        vector<int> slots = sessionStore.writeRecords(writes, nullptr);
+        if(sessionStore.sync(nullptr)) {
+            lock_guard<mutex> lock(dataMutex);
+            for(size_t i = 0; i < chosen.size(); i++) {
+                const PersistSnapshot& record = *chosen[i];
+                if(slots[i] < 0) {
+                    written = false;
+                    continue;
+                }
+                long position = sessionIndex.find(record.courseCode, record.date, record.startTime);
+                if(position >= 0) sessions[position].markStored(sessionStore, slots[i], record.version);
+                pending.sessionRecords.erase(record.sessionKey());
+            }
+        } else {
+            written = false;
+        }
+    }
+    
+    if(!pending.marks.empty()) {
+        if(journal.append(pending.marks)) {
+            pending.marks.clear();
+            compactor.notifyCommitted();
+        } else {
+            // No journal: save the marked sessions themselves instead
+            lock_guard<mutex> lock(dataMutex);
+            bool saved = false;
+            saveDirtySessions(false, &saved);
+            if(saved) {
+                pending.marks.clear();
+            } else {
+                written = false;
+            }
+        }
+    }
+    return written;
+}
+
+// Compactor callback: fold the journal into session snapshots. The
+// sessions are encoded under dataMutex, but written and synced without
+// it, so marking is not held up by the disk. The journal is reset only
+// if no session changed meanwhile: a mark made after the encoding may
+// already be in it.
+inline void compactJournal() {
+    SaveStats stats;
+    DirtySessions dirty;
+    {
+        lock_guard<mutex> lock(dataMutex);
+        encodeDirtySessions(dirty, stats, false);
+    }
+    storeDirtySessions(dirty, stats, false);
+    lock_guard<mutex> lock(dataMutex);
+    markDirtySessionsStored(dirty, false);
+    if(!dirty.saved) return;
+    for(const auto& session : sessions) {
+        if(session.isDirty()) return;
+    }
+    journal.reset();
+}
+
+// Make a session's roster and marks available, then evict the least
+// recently used clean sessions until the resident budget is met. The
+// session must be one of sessions. Dirty sessions waiting for a save are
+// skipped, so an eviction only walks past those. Callers hold dataMutex.
+inline bool touchSessionLocked(AttendanceSession &session) {
+    if(!session.ensureResident()) {
+        return false;
+    }
+    
+    if(session.isOnLruList()) {
+        residentSessions.splice(residentSessions.begin(), residentSessions, session.getLruEntry());
+    } else {
+        residentSessions.push_front(static_cast<size_t>(&session - sessions.data()));
+        session.setLruEntry(residentSessions.begin());
+    }
+    auto entry = residentSessions.end();
+    while(residentSessions.size() > MAX_RESIDENT_SESSIONS) {
+        --entry;
+        if(entry == residentSessions.begin()) break; // only the touched session is left
+        AttendanceSession& coldest = sessions[*entry];
+        if(coldest.isResident() && !coldest.evict()) continue;
+        coldest.clearLruEntry();
+        entry = residentSessions.erase(entry);
+    }
+    return true;
+}
+
+inline bool touchSession(AttendanceSession &session) {
+    lock_guard<mutex> lock(dataMutex);
+    return touchSessionLocked(session);
+}
+
+// Read students.txt and the session store, migrate old session files and
+// replay the journal. False if the session store cannot be opened.
+inline bool loadAllData() {
+    STAT_SCOPE(TIMER_LOAD);
+    
+    // Load students
+    string studentText;
+    if(readWholeFile(STUDENT_FILE, studentText)) {
+        STAT_ADD(STAT_FILES_READ, 1);
+        STAT_ADD(STAT_BYTES_READ, studentText.size());
+        vector<ParseError> errors;
+        unsigned threadCount = loadThreads > 0 ? loadThreads : thread::hardware_concurrency();
+        loadStudentsBulk(studentText, students, errors, threadCount);
+        students.markSaved();
+        cout << "✓ Loaded " << students.size() << " students from file.\n";
+        STAT_ADD(STAT_PARSE_ERRORS, errors.size());
+        if(!errors.empty()) {
+            cout << "✗ Warning: skipped " << errors.size() << " malformed or repeated line(s) in " << STUDENT_FILE << ":\n";
+            reportParseErrors(cout, STUDENT_FILE, errors);
+        }
+    }
+    
+    // Shared roster versions, which session records refer to
+    loadRosters();
+    
+    // Load sessions from the session store; only the index is read here,
+    // rosters fault in when a session is used
+    auto loadStart = chrono::steady_clock::now();
+    if(!sessionStore.open(SESSION_DATA_FILE, SESSION_INDEX_FILE)) {
+        cout << "✗ Error: Could not open the session store (" << SESSION_DATA_FILE << ", " << SESSION_INDEX_FILE << ").\n";
+        return false;
+    }
+    vector<int> liveSlots = sessionStore.liveEntries();
+    sessions.reserve(liveSlots.size());
+    for(int slot : liveSlots) {
+        AttendanceSession session;
+        session.loadHeaderFromStore(sessionStore, slot, students);
+        sessions.push_back(session);
+    }
+    double loadSeconds = chrono::duration<double>(chrono::steady_clock::now() - loadStart).count();
+    if(!sessions.empty()) {
+        cout << "✓ Loaded " << sessions.size() << " sessions from " << SESSION_INDEX_FILE
+             << " (" << fixed << setprecision(1) << loadSeconds * 1000 << " ms).\n";
+        cout.unsetf(ios::fixed);
+        cout << setprecision(6);
+    }
+    
+    migrateSessionFiles();
+    
+    sessionIndex.clear();
+    for(size_t i = 0; i < sessions.size(); i++) {
+        sessionIndex.insert(sessions[i], i);
+    }
+    
+    // Replay marks journaled after the session snapshots were written;
+    // each session they touch is counted against the resident budget once,
+    // after the replay, not once per record
+    map<string, size_t> sessionsByKey;
+    for(size_t i = 0; i < sessions.size(); i++) {
+        sessionsByKey[sessions[i].getKey()] = i;
+    }
+    vector<uint8_t> replayedInto(sessions.size(), 0);
+    vector<uint8_t> unreadable(sessions.size(), 0);
+    int badRecords = 0;
+    int orphaned = 0;
+    int unapplied = 0;
+    size_t validBytes = 0;
+    int replayed = journal.replay([&](const JournalEntry& entry) {
+        auto it = sessionsByKey.find(entry.sessionKey);
+        if(it == sessionsByKey.end()) {
+            orphaned++;
+            return;
+        }
+        if(unreadable[it->second] || !sessions[it->second].markAttendance(students.intern(entry.index), entry.status)) {
+            unreadable[it->second] = 1;
+            unapplied++;
+            return;
+        }
+        replayedInto[it->second] = 1;
+    }, badRecords, validBytes);
+    for(size_t i = 0; i < sessions.size(); i++) {
+        if(replayedInto[i]) touchSession(sessions[i]);
+    }
+    if(replayed > 0) {
+        cout << "✓ Replayed " << replayed - orphaned - unapplied << " of " << replayed << " journaled marks";
+        if(orphaned > 0) cout << " (" << orphaned << " for unknown sessions)";
+        cout << ".\n";
+    }
+    if(unapplied > 0) {
+        cout << "✗ Warning: " << unapplied << " journaled mark(s) not applied; the record of these sessions could not be read:\n";
+        for(size_t i = 0; i < sessions.size(); i++) {
+            if(unreadable[i]) cout << "  " << sessions[i].getCourseCode() << "/" << sessions[i].getDate() << "/" << sessions[i].getStartTime() << endl;
+        }
+        cout << "  The marks are kept in " << JOURNAL_FILE << ", which is no longer compacted.\n";
+        journal.keepUnapplied();
+    }
+    if(badRecords > 0) {
+        cout << "✗ Warning: ignored " << badRecords << " damaged journal record(s).\n";
+        journal.truncateTo(validBytes);
+    }
+    cout << endl;
+    return true;
+}
+
+// Move session_*.bin / session_*.txt files written by older versions into
+// the session store. The files are parsed on a worker pool, merged in
+// filename order, written to the store with one sync, and removed once
+// the store is durable. A session already in the store wins over its file.
+inline void migrateSessionFiles() {
+    STAT_SCOPE(TIMER_MIGRATE);
+    vector<fs::path> sessionFiles;
+    for(const auto& entry : fs::directory_iterator(".")) {
+        string filename = entry.path().filename().string();
+        if(filename.find("session_") == 0 && filename.length() > 12) {
+            sessionFiles.push_back(entry.path());
+        }
+    }
+    if(sessionFiles.empty()) return;
+    
+    // Sorted so the merged order does not depend on the directory order
+    sort(sessionFiles.begin(), sessionFiles.end());
+    vector<string> candidates;
+    vector<string> superseded;
+    for(const auto& path : sessionFiles) {
+        string extension = path.extension().string();
+        if(extension == ".txt") {
+            // Both can exist after an interrupted conversion; the binary copy wins
+            if(fs::exists(path.stem().string() + ".bin")) {
+                superseded.push_back(path.filename().string());
+                continue;
+            }
+        } else if(extension != ".bin") {
+            continue;
+        }
+        candidates.push_back(path.filename().string());
+    }
+    
+    // The registry is shared read-only, so a file naming a student not in
+    // students.txt is left for the main thread
+    unsigned threadCount = loadThreads > 0 ? loadThreads : thread::hardware_concurrency();
+    if(threadCount == 0) threadCount = 1;
+    if(threadCount > candidates.size()) threadCount = max<size_t>(candidates.size(), 1);
+    
+    enum { LOAD_FAILED, LOAD_OK, LOAD_RETRY };
+    vector<AttendanceSession> loaded(candidates.size());
+    vector<char> outcome(candidates.size(), LOAD_FAILED);
+    vector<double> secondsPerThread(threadCount, 0);
+    atomic<size_t> nextFile(0);
+    
+    auto loadStart = chrono::steady_clock::now();
+    auto worker = [&](unsigned t) {
+        auto start = chrono::steady_clock::now();
+        size_t i;
+        while((i = nextFile.fetch_add(1)) < candidates.size()) {
+            if(loaded[i].loadFromFile(candidates[i], students, true)) {
+                outcome[i] = LOAD_OK;
+            } else if(loaded[i].needsSerialLoad()) {
+                outcome[i] = LOAD_RETRY;
+            }
+        }
+        secondsPerThread[t] = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    };
+    vector<thread> pool;
+    for(unsigned t = 1; t < threadCount; t++) {
+        pool.emplace_back(worker, t);
+    }
+    worker(0);
+    for(auto& th : pool) {
+        th.join();
+    }
+    
+    // Only a file whose session is now in the store under the same key is
+    // removed; any other is kept for the next start
+    int migrated = 0;
+    vector<char> inStore(candidates.size(), 0);
+    size_t firstNew = sessions.size();
+    for(size_t i = 0; i < candidates.size(); i++) {
+        if(outcome[i] == LOAD_RETRY) {
+            loaded[i] = AttendanceSession();
+            if(loaded[i].loadFromFile(candidates[i], students)) {
+                outcome[i] = LOAD_OK;
+            }
+        }
+        if(outcome[i] != LOAD_OK) {
+            cout << "✗ Could not migrate " << candidates[i] << ": " << loaded[i].getLoadError() << endl;
+            continue;
+        }
+        AttendanceSession& session = loaded[i];
+        if(!SessionStore::fitsIndex(session.getCourseCode(), session.getDate(), session.getStartTime(), session.getDuration())) {
+            cout << "✗ Could not migrate " << candidates[i] << ": course code, date, time or duration too long for "
+                 << SESSION_DATA_FILE << " (course codes hold " << MAX_COURSE_CODE_LENGTH << " characters); file kept.\n";
+            continue;
+        }
+        if(sessionStore.find(session.getCourseCode(), session.getDate(), session.getStartTime()) >= 0) {
+            inStore[i] = 1;
+            continue;
+        }
+        // Files sharing a roster store it once, as a roster version
+        session.shareRoster();
+        if(!session.saveToStore(sessionStore)) continue;
+        sessions.push_back(move(session));
+        inStore[i] = 1;
+        migrated++;
+    }
+    if(!saveRosters() || !sessionStore.sync(nullptr)) {
+        cout << "✗ Error: Could not write the session store; session files kept.\n";
+        return;
+    }
+    for(size_t i = firstNew; i < sessions.size(); i++) {
+        sessions[i].evict();
+    }
+    for(size_t i = 0; i < candidates.size(); i++) {
+        if(inStore[i]) remove(candidates[i].c_str());
+    }
+    // A text copy goes with the binary copy that superseded it
+    for(const auto& filename : superseded) {
+        if(!fs::exists(fs::path(filename).stem().string() + ".bin")) remove(filename.c_str());
+    }
+    double loadSeconds = chrono::duration<double>(chrono::steady_clock::now() - loadStart).count();
+    
+    double busySeconds = 0;
+    for(double sec : secondsPerThread) busySeconds += sec;
+    cout << "✓ Migrated " << migrated << " session file(s) into " << SESSION_DATA_FILE << " ("
+         << candidates.size() << " files in " << fixed << setprecision(1) << loadSeconds * 1000 << " ms, "
+         << threadCount << " thread(s), "
+         << setprecision(0) << (busySeconds > 0 ? candidates.size() / busySeconds : 0) << " files/s per thread).\n";
+    cout.unsetf(ios::fixed);
+    cout << setprecision(6);
+}
+
+// Call visit for each of the sessions at positions with its roster and
+// marks in memory. Sessions that are not resident are read into
+// temporary copies, BATCH_READ_SESSIONS records per batched read, so the
+// LRU budget is not disturbed. False if a session could not be read.
+// Callers hold dataMutex.
+const size_t BATCH_READ_SESSIONS = 256;
+
+inline bool visitSessions(const vector<size_t>& positions, const function<void(const AttendanceSession&)>& visit) {
+    STAT_SCOPE(TIMER_FAULT_IN);
+    bool allRead = true;
+    vector<AttendanceSession> copies;
+    vector<int> slots;
+    vector<string> records;
+    vector<char> readOk;
+    auto readCopies = [&]() {
+        sessionStore.readRecords(slots, records, readOk);
+        for(size_t i = 0; i < copies.size(); i++) {
+            if(copies[i].makeResident(readOk[i] ? &records[i] : nullptr)) visit(copies[i]);
+            else allRead = false;
+        }
+        copies.clear();
+        slots.clear();
+    };
+    for(size_t position : positions) {
+        const AttendanceSession& session = sessions[position];
+        if(session.isResident()) {
+            visit(session);
+            continue;
+        }
+        copies.push_back(session);
+        slots.push_back(session.getStoreSlot());
+        if(copies.size() == BATCH_READ_SESSIONS) readCopies();
+    }
+    if(!copies.empty()) readCopies();
+    return allRead;
+}
+
+// Compute every student's running totals from all sessions. Runs once,
+// on first use; after that markAttendance keeps the totals current.
+// Callers hold dataMutex.
+inline void buildAttendanceCountsLocked() {
+    if(students.countsActive()) return;
+    students.resetCounts();
+    vector<size_t> positions(sessions.size());
+    for(size_t i = 0; i < positions.size(); i++) positions[i] = i;
+    visitSessions(positions, [](const AttendanceSession& session) { session.addToCounts(students); });
+    students.activateCounts();
+}
+
+inline void buildAttendanceCounts() {
+    lock_guard<mutex> lock(dataMutex);
+    buildAttendanceCountsLocked();
+}
+
+// Build every student's history over the sessions, in (date, time,
+// course) order so each student's marks are appended run by run. Runs
+// once, like the totals; markAttendance keeps it current after that.
+// Callers hold dataMutex.
+inline void buildAttendanceHistoryLocked() {
+    AttendanceHistory& history = students.history();
+    if(history.active()) return;
+    history.reset();
+    vector<tuple<string, string, string>> keys;
+    keys.reserve(sessions.size());
+    for(const auto& session : sessions) {
+        keys.emplace_back(session.getDate(), session.getStartTime(), session.getCourseCode());
+    }
+    vector<size_t> positions(sessions.size());
+    for(size_t i = 0; i < positions.size(); i++) positions[i] = i;
+    sort(positions.begin(), positions.end(), [&](size_t a, size_t b) { return keys[a] < keys[b]; });
+    for(size_t position : positions) {
+        AttendanceSession& session = sessions[position];
+        session.setHistoryColumn(history.addColumn(session.getCourseCode(), session.getDate(), session.getStartTime()));
+    }
+    visitSessions(positions, [](const AttendanceSession& session) { session.addToHistory(students); });
+    history.shrink();
+    history.activate();
+}
+
+inline void buildAttendanceHistory() {
+    lock_guard<mutex> lock(dataMutex);
+    buildAttendanceHistoryLocked();
+}
+
+inline string statsToJson(const StatTotals& totals) {
+    string json = "{\n  \"pid\": " + to_string(getpid()) + ",\n  \"timestamp\": " + to_string(time(nullptr))
+                + ",\n  \"counters\": {";
+    for(int i = 0; i < STAT_COUNTER_COUNT; i++) {
+        json += string(i > 0 ? "," : "") + "\n    \"" + STAT_COUNTER_NAMES[i] + "\": " + to_string(totals.counters[i]);
+    }
+    json += "\n  },\n  \"timers\": {";
+    for(int i = 0; i < TIMER_COUNT; i++) {
+        json += string(i > 0 ? "," : "") + "\n    \"" + STAT_TIMER_NAMES[i] + "\": {\"calls\": " + to_string(totals.timerCalls[i])
+              + ", \"total_ns\": " + to_string(totals.timerNanos[i]) + ", \"max_ns\": " + to_string(totals.timerMaxNanos[i]) + "}";
+    }
+    json += "\n  }\n}\n";
+    return json;
+}
+
+// Write the statistics as JSON through a temporary file, so a reader
+// never sees a half-written dump
+inline bool writeStatsFile(const string& filename) {
+    return writeFileDurably(filename, statsToJson(statsSnapshot()));
+}
+
+inline string toUpperCase(string str) {
+    for(char &c : str) {
+        c = toupper(c);
+    }
+    return str;
+}
+
+inline bool isValidDate(string date) {
+    if(date.length() != 10) return false;
+    if(date[4] != '-' || date[7] != '-') return false;
+    
+    for(int i = 0; i < 10; i++) {
+        if(i == 4 || i == 7) continue;
+        if(!isdigit(date[i])) return false;
+    }
+    
+    // Basic range validation
+    int year = stoi(date.substr(0, 4));
+    int month = stoi(date.substr(5, 2));
+    int day = stoi(date.substr(8, 2));
+    
+    if(year < 2024 || year > 2026) return false;
+    if(month < 1 || month > 12) return false;
+    if(day < 1 || day > 31) return false;
+    
+    return true;
+}
+
+inline bool isValidTime(string time) {
+    if(time.length() != 5) return false;
+    if(time[2] != ':') return false;
+    
+    for(int i = 0; i < 5; i++) {
+        if(i == 2) continue;
+        if(!isdigit(time[i])) return false;
+    }
+    
+    int hours = stoi(time.substr(0, 2));
+    int minutes = stoi(time.substr(3, 2));
+    
+    return (hours >= 0 && hours <= 23 && minutes >= 0 && minutes <= 59);
+}
+
+inline bool isValidDuration(string dur) {
+    if(dur.empty()) return false;
+    for(char c : dur) {
+        if(!isdigit(c)) return false;
+    }
+    int duration = stoi(dur);
+    return (duration > 0 && duration <= 4);
+}
+
+inline string statusToString(AttendanceStatus status) {
+    switch(status) {
+        case PRESENT: return "PRESENT";
+        case ABSENT: return "ABSENT";
+        case LATE: return "LATE";
+        default: return "UNKNOWN";
+    }
+}
+
+inline char statusToChar(AttendanceStatus status) {
+    switch(status) {
+        case PRESENT: return 'P';
+        case ABSENT: return 'A';
+        case LATE: return 'L';
+        default: return '?';
+    }
+}
+
+// Status letters accepted when marking: P, A or L in either case
+inline bool isValidStatusChar(char c) {
+    c = toupper(c);
+    return c == 'P' || c == 'A' || c == 'L';
+}
+
+inline AttendanceStatus charToStatus(char c) {
+    c = toupper(c);
+    switch(c) {
+        case 'P': return PRESENT;
+        case 'A': return ABSENT;
+        case 'L': return LATE;
+        default: return ABSENT;
+    }
+}
+
+// Single-session report: header fields, the roster with each student's
+// status and the summary. The session must be resident.
+inline void renderSessionReport(AttendanceSession& session, ReportWriter& report) {
+    STAT_SCOPE(TIMER_REPORT);
+    report.title("ATTENDANCE REPORT");
+    report.field("Course", session.getCourseCode());
+    report.field("Date", session.getDate());
+    report.field("Time", session.getStartTime());
+    report.field("Duration", session.getDuration() + " hours");
+    report.field("Record", session.getRecordName());
+    
+    if(!session.isAttendanceMarked()) {
+        report.note("");
+        report.note("Attendance has not been marked for this session yet.");
+        return;
+    }
+    
+    report.section("ATTENDANCE LIST");
+    report.beginTable({{"Index", 15, false}, {"Name", 30, false}, {"Status", 0, false}});
+    string statusText;
+    for(uint32_t id : session.getRosterIds()) {
+        AttendanceStatus status = session.getAttendanceStatus(id);
+        statusText.assign(1, '[');
+        statusText += statusToChar(status);
+        statusText += "] ";
+        statusText += statusToString(status);
+        report.row({students[id].getIndexNumber(), students[id].getName(), statusText});
+    }
+    report.endTable();
+    
+    int present, absent, late;
+    session.getSummary(present, absent, late);
+    int total = present + absent + late;
+    
+    report.section("SUMMARY");
+    report.field("Total Students", to_string(total));
+    report.field("Present", to_string(present) + " (" + formatPercent(present, total) + ")");
+    report.field("Absent", to_string(absent) + " (" + formatPercent(absent, total) + ")");
+    report.field("Late", to_string(late) + " (" + formatPercent(late, total) + ")");
+}
+
+// Per-student totals over the given sessions, read in batches; false if
+// a session could not be read
+inline bool collectStudentTotals(const vector<size_t>& matches, vector<AttendanceCounts>& totals) {
+    lock_guard<mutex> lock(dataMutex);
+    totals.assign(students.idCount(), AttendanceCounts());
+    return visitSessions(matches, [&](const AttendanceSession& session) {
+        bool marked = session.isAttendanceMarked();
+        for(uint32_t id : session.getRosterIds()) {
+            if(id >= totals.size()) totals.resize(id + 1);
+            AttendanceCounts& c = totals[id];
+            c.enrolled++;
+            if(!marked || !session.isMarked(id)) continue;
+            switch(session.getAttendanceStatus(id)) {
+                case PRESENT: c.present++; break;
+                case LATE: c.late++; break;
+                case ABSENT: c.absent++; break;
+            }
+        }
+    });
+}
+
+inline void renderStudentTotals(const vector<AttendanceCounts>& totals, ReportWriter& report) {
+    report.section("STUDENTS");
+    report.beginTable({{"Index", 15, false}, {"Name", 25, false}, {"Sessions", 9, true}, {"Present", 8, true},
+                       {"Late", 6, true}, {"Absent", 8, true}, {"Rate", 9, true}});
+    for(uint32_t id = 0; id < totals.size(); id++) {
+        const AttendanceCounts& c = totals[id];
+        if(c.enrolled == 0 || !students.isRegistered(id)) continue;
+        int marked = static_cast<int>(c.present + c.late + c.absent);
+        report.row({students[id].getIndexNumber(), students[id].getName(), to_string(c.enrolled), to_string(c.present),
+                    to_string(c.late), to_string(c.absent),
+                    marked > 0 ? formatPercent(static_cast<int>(c.present + c.late), marked) : string("-")});
+    }
+    report.endTable();
+    report.note("Rate = (present + late) / sessions marked for the student.");
+}
+
+// Course report: every matching session with its summary, then each
+// student's totals over those sessions
+inline bool renderCourseReport(const vector<size_t>& matches, const string& label, ReportWriter& report) {
+    STAT_SCOPE(TIMER_REPORT);
+    report.title("COURSE REPORT");
+    report.field("Courses", label);
+    report.field("Sessions", to_string(matches.size()));
+    
+    report.section("SESSIONS");
+    report.beginTable({{"Course", 10, false}, {"Date", 12, false}, {"Time", 7, false}, {"Hours", 6, true},
+                       {"Present", 9, true}, {"Late", 6, true}, {"Absent", 8, true}, {"Rate", 9, true}});
+    for(size_t position : matches) {
+        const AttendanceSession& session = sessions[position];
+        int p, a, l;
+        session.getSummary(p, a, l);
+        int marked = p + a + l;
+        report.row({session.getCourseCode(), session.getDate(), session.getStartTime(), session.getDuration(),
+                    to_string(p), to_string(l), to_string(a), marked > 0 ? formatPercent(p + l, marked) : string("-")});
+    }
+    report.endTable();
+    
+    vector<AttendanceCounts> totals;
+    if(!collectStudentTotals(matches, totals)) return false;
+    renderStudentTotals(totals, report);
+    return true;
+}
+
+// Semester report: one summary row per course over the date range, then
+// each student's totals across all of them
+inline bool renderSemesterReport(const vector<size_t>& matches, const string& fromDate, const string& toDate, ReportWriter& report) {
+    STAT_SCOPE(TIMER_REPORT);
+    report.title("SEMESTER REPORT");
+    report.field("From", fromDate);
+    report.field("To", toDate);
+    report.field("Sessions", to_string(matches.size()));
+    
+    report.section("COURSES");
+    report.beginTable({{"Course", 10, false}, {"Sessions", 9, true}, {"Present", 9, true}, {"Late", 7, true},
+                       {"Absent", 8, true}, {"Rate", 9, true}});
+    // Matches are in course order, so each course is one run
+    for(size_t i = 0; i < matches.size();) {
+        const string& course = sessions[matches[i]].getCourseCode();
+        int count = 0, present = 0, absent = 0, late = 0;
+        for(; i < matches.size() && sessions[matches[i]].getCourseCode() == course; i++) {
+            int p, a, l;
+            sessions[matches[i]].getSummary(p, a, l);
+            present += p;
+            absent += a;
+            late += l;
+            count++;
+        }
+        int marked = present + absent + late;
+        report.row({course, to_string(count), to_string(present), to_string(late), to_string(absent),
+                    marked > 0 ? formatPercent(present + late, marked) : string("-")});
+    }
+    report.endTable();
+    
+    vector<AttendanceCounts> totals;
+    if(!collectStudentTotals(matches, totals)) return false;
+    renderStudentTotals(totals, report);
+    return true;
+}
+
+// ---- Programmatic API ----
+// Non-interactive entry points for embedding the core, batch tools and
+// load tests. Arguments are validated the way the menu prompts validate
+// them, every call holds dataMutex for the whole of its access to students
+// and sessions, and the outcome comes back as a CoreResult; nothing reads
+// cin. A session is named by its position in sessions, which stays valid
+// for the life of the process.
+//
+// dataMutex guards students and sessions against the background writer,
+// the compactor and other threads. Code outside these calls holds it
+// while it changes them, and while it reads them if another thread may
+// change them at the same time (the daemon's handlers, the live marker).
+// Only the single-threaded menu, the one thread that adds students and
+// sessions there, reads them without it. coreLockData is the lock between
+// processes and does not replace dataMutex.
+
+enum CoreResult {
+    CORE_OK,
+    CORE_INVALID_ARGUMENT, // malformed index, course code, date, time or duration
+    CORE_DUPLICATE,        // the student or session already exists
+    CORE_NOT_FOUND,        // no such student or session
+    CORE_NOT_ON_ROSTER,    // the student is not on the session's roster
+    CORE_NO_STUDENTS,      // a session needs registered students
+    CORE_IO_ERROR,         // could not read or write the data files
+    CORE_LOCKED            // another process (usually attendanced) owns the data
+};
+
+inline const char* coreResultMessage(CoreResult result) {
+    switch(result) {
+        case CORE_OK: return "ok";
+        case CORE_INVALID_ARGUMENT: return "invalid argument";
+        case CORE_DUPLICATE: return "already exists";
+        case CORE_NOT_FOUND: return "not found";
+        case CORE_NOT_ON_ROSTER: return "not on the session roster";
+        case CORE_NO_STUDENTS: return "no students registered";
+        case CORE_IO_ERROR: return "could not read or write the data files";
+        case CORE_LOCKED: return "the data is in use by another process (is attendanced running?)";
+        default: return "unknown error";
+    }
+}
+
+// Take the data directory for this process. The lock is held until exit,
+// so two programs never append to the same students.txt or store.
+inline CoreResult coreLockData() {
+    static int lockFd = -1;
+    if(lockFd >= 0) return CORE_OK;
+    int fd = open(LOCK_FILE.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if(fd < 0) return CORE_IO_ERROR;
+    if(flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        ::close(fd);
+        return errno == EWOULDBLOCK ? CORE_LOCKED : CORE_IO_ERROR;
+    }
+    lockFd = fd;
+    return CORE_OK;
+}
+
+// Lock the data, load everything and start the compactor. Call once,
+// before any other call; nothing is loaded if the data is locked.
+inline CoreResult coreOpen() {
+    CoreResult locked = coreLockData();
+    if(locked != CORE_OK) return locked;
+    
+    // Temporary files of a save interrupted by a crash; the files they
+    // were meant to replace are intact
+    error_code ec;
+    for(const auto& entry : fs::directory_iterator(".", ec)) {
+        string filename = entry.path().filename().string();
+        if(filename.rfind(STUDENT_FILE + ".tmp", 0) == 0 || filename.rfind(ROSTER_FILE + ".tmp", 0) == 0
+           || filename.rfind(STATS_FILE + ".tmp", 0) == 0) {
+            fs::remove(entry.path(), ec);
+        }
+    }
+    bool loaded = loadAllData();
+    compactor.start();
+    return loaded ? CORE_OK : CORE_IO_ERROR;
+}
+
+// Immutable copy of a session's current record for the background
+// writer. Callers hold dataMutex and the session is resident.
+inline shared_ptr<const PersistSnapshot> snapshotSession(const AttendanceSession& session) {
+    auto snapshot = make_shared<PersistSnapshot>();
+    snapshot->kind = PersistSnapshot::SESSION_RECORD;
+    session.encodeBinary(snapshot->data);
+    snapshot->courseCode = session.getCourseCode();
+    snapshot->date = session.getDate();
+    snapshot->startTime = session.getStartTime();
+    snapshot->duration = session.getDuration();
+    snapshot->version = session.getVersion();
+    return snapshot;
+}
+
+// Hand new students and changed sessions to the background writer and
+// return at once; coreFlush waits for them. CORE_IO_ERROR if an earlier
+// background write failed or a changed session has no record to save.
+inline CoreResult coreSave() {
+    vector<shared_ptr<const PersistSnapshot>> snapshots;
+    bool unsnapshotted = false;
+    {
+        lock_guard<mutex> lock(dataMutex);
+        const vector<uint32_t>& unsavedIds = students.getUnsavedIds();
+        if(!unsavedIds.empty()) {
+            auto rows = make_shared<PersistSnapshot>();
+            rows->kind = PersistSnapshot::STUDENT_ROWS;
+            for(uint32_t id : unsavedIds) {
+                rows->data += students[id].toCSV();
+                rows->data += '\n';
+            }
+            students.markSaved();
+            snapshots.push_back(rows);
+        }
+        for(auto& session : sessions) {
+            if(!session.isDirty()) continue;
+            // A dirty session is never evicted, so this is one whose
+            // record could not be read back
+            if(!session.isResident()) {
+                unsnapshotted = true;
+                continue;
+            }
+            snapshots.push_back(snapshotSession(session));
+        }
+    }
+    // Submitted without the lock: the writer takes it to record what it wrote
+    for(auto& snapshot : snapshots) {
+        backgroundWriter.submit(move(snapshot));
+    }
+    return backgroundWriter.hasLeftovers() || unsnapshotted ? CORE_IO_ERROR : CORE_OK;
+}
+
+// Wait until everything handed to the background writer is on disk
+inline CoreResult coreFlush() {
+    return backgroundWriter.flush() ? CORE_OK : CORE_IO_ERROR;
+}
+
+// Stop the compactor, write out everything still queued, then save
+// whatever is left synchronously; the core is not used afterwards
+inline CoreResult coreClose() {
+    compactor.stop();
+    bool flushed = backgroundWriter.stop();
+    lock_guard<mutex> lock(dataMutex);
+    return saveAllData() && flushed ? CORE_OK : CORE_IO_ERROR;
+}
+
+// Register a student. The index is upper-cased; the student is kept in
+// memory until the next coreSave.
+inline CoreResult coreRegisterStudent(const string& indexNumber, const string& name) {
+    string index = toUpperCase(indexNumber);
+    if(index.empty() || index.find(',') != string::npos || name.find('\n') != string::npos) {
+        return CORE_INVALID_ARGUMENT;
+    }
+    lock_guard<mutex> lock(dataMutex);
+    if(students.contains(index)) return CORE_DUPLICATE;
+    students.insert(Student(index, name));
+    return CORE_OK;
+}
+
+inline CoreResult coreFindStudent(const string& indexNumber, Student& student) {
+    lock_guard<mutex> lock(dataMutex);
+    const Student* found = students.find(toUpperCase(indexNumber));
+    if(found == nullptr) return CORE_NOT_FOUND;
+    student = *found;
+    return CORE_OK;
+}
+
+// Create a session with every registered student on its roster and write
+// it to the store. On CORE_IO_ERROR the session exists in memory and is
+// written again by the next save.
+inline CoreResult coreCreateSession(const string& course, const string& date, const string& startTime,
+                                    const string& duration, size_t* position = nullptr) {
+    string courseCode = toUpperCase(course);
+    if(courseCode.empty() || courseCode.length() > MAX_COURSE_CODE_LENGTH || !isValidDate(date)
+       || !isValidTime(startTime) || !isValidDuration(duration)) {
+        return CORE_INVALID_ARGUMENT;
+    }
+    unique_lock<mutex> lock(dataMutex);
+    if(students.empty()) return CORE_NO_STUDENTS;
+    if(sessionIndex.find(courseCode, date, startTime) >= 0) return CORE_DUPLICATE;
+    
+    AttendanceSession newSession(courseCode, date, startTime, duration);
+    newSession.addAllStudents(students);
+    sessions.push_back(move(newSession));
+    sessionIndex.insert(sessions.back(), sessions.size() - 1);
+    if(students.history().active()) {
+        // A session dated before the last column needs the history rebuilt
+        int column = students.history().addColumn(courseCode, date, startTime);
+        if(column >= 0) sessions.back().setHistoryColumn(column);
+        else students.history().reset();
+    }
+    if(position != nullptr) *position = sessions.size() - 1;
+    auto snapshot = snapshotSession(sessions.back());
+    lock.unlock();
+    
+    backgroundWriter.submit(move(snapshot));
+    return CORE_OK;
+}
+
+inline CoreResult coreFindSession(const string& course, const string& date, const string& startTime, size_t& position) {
+    lock_guard<mutex> lock(dataMutex);
+    long found = sessionIndex.find(toUpperCase(course), date, startTime);
+    if(found < 0) return CORE_NOT_FOUND;
+    position = static_cast<size_t>(found);
+    return CORE_OK;
+}
+
+// Positions of the sessions of a course (or of every course starting with
+// it when prefix is set) between two dates, in (course, date, time) order
+inline vector<size_t> coreQuerySessions(const string& course, bool prefix, const string& fromDate, const string& toDate) {
+    lock_guard<mutex> lock(dataMutex);
+    return sessionIndex.query(toUpperCase(course), prefix, fromDate, toDate);
+}
+
+// Student IDs of a batch of marks, in order; CORE_NOT_FOUND or
+// CORE_NOT_ON_ROSTER for the first student that cannot be marked.
+// Callers hold dataMutex and the session is resident.
+inline CoreResult resolveRosterIds(const AttendanceSession& session, const vector<pair<string, AttendanceStatus>>& marks,
+                                   vector<uint32_t>& ids) {
+    vector<uint8_t> onRoster(students.idCount(), 0);
+    for(uint32_t id : session.getRosterIds()) {
+        onRoster[id] = 1;
+    }
+    ids.clear();
+    ids.reserve(marks.size());
+    for(const auto& mark : marks) {
+        int32_t id = students.findId(mark.first);
+        if(id == StudentRegistry::NO_ID || !students.isRegistered(static_cast<uint32_t>(id))) return CORE_NOT_FOUND;
+        if(!onRoster[id]) return CORE_NOT_ON_ROSTER;
+        ids.push_back(static_cast<uint32_t>(id));
+    }
+    return CORE_OK;
+}
+
+// Check a batch of marks without applying it, so callers can merge
+// several checked batches into one coreMarkAttendance
+inline CoreResult coreCheckMarks(size_t position, const vector<pair<string, AttendanceStatus>>& marks) {
+    lock_guard<mutex> lock(dataMutex);
+    if(position >= sessions.size()) return CORE_NOT_FOUND;
+    if(!touchSessionLocked(sessions[position])) return CORE_IO_ERROR;
+    vector<uint32_t> ids;
+    return resolveRosterIds(sessions[position], marks, ids);
+}
+
+// Mark a batch of (index, status) pairs in one session. The batch is
+// checked first and applied only if every student is on the roster; it
+// is committed to the journal with one fsync and folded into the store
+// by the compactor. If the journal cannot be written the session is
+// saved directly, and CORE_IO_ERROR means that failed too.
+inline CoreResult coreMarkAttendance(size_t position, const vector<pair<string, AttendanceStatus>>& marks) {
+    STAT_SCOPE(TIMER_MARK);
+    auto snapshot = make_shared<PersistSnapshot>();
+    snapshot->kind = PersistSnapshot::JOURNAL_BATCH;
+    {
+        lock_guard<mutex> lock(dataMutex);
+        if(position >= sessions.size()) return CORE_NOT_FOUND;
+        AttendanceSession& session = sessions[position];
+        if(!touchSessionLocked(session)) return CORE_IO_ERROR;
+        
+        vector<uint32_t> ids;
+        CoreResult resolved = resolveRosterIds(session, marks, ids);
+        if(resolved != CORE_OK) return resolved;
+        
+        snapshot->marks.reserve(marks.size());
+        long long now = static_cast<long long>(time(nullptr));
+        for(size_t i = 0; i < marks.size(); i++) {
+            snapshot->marks.push_back({session.getKey(), students[ids[i]].getIndexNumber(), marks[i].second, now});
+            session.markAttendance(ids[i], marks[i].second);
+        }
+    }
+    // The marks are applied; the writer journals them (or, failing that,
+    // saves the session) in the background
+    backgroundWriter.submit(move(snapshot));
+    return CORE_OK;
+}
+
+// A student's mark in one session; marked is false if none was recorded
+inline CoreResult coreStudentStatus(size_t position, const string& indexNumber, AttendanceStatus& status, bool& marked) {
+    lock_guard<mutex> lock(dataMutex);
+    if(position >= sessions.size()) return CORE_NOT_FOUND;
+    AttendanceSession& session = sessions[position];
+    if(!touchSessionLocked(session)) return CORE_IO_ERROR;
+    int32_t id = students.findId(toUpperCase(indexNumber));
+    if(id == StudentRegistry::NO_ID) return CORE_NOT_FOUND;
+    const vector<uint32_t>& roster = session.getRosterIds();
+    if(find(roster.begin(), roster.end(), static_cast<uint32_t>(id)) == roster.end()) return CORE_NOT_ON_ROSTER;
+    marked = session.isMarked(static_cast<uint32_t>(id));
+    status = session.getAttendanceStatus(static_cast<uint32_t>(id));
+    return CORE_OK;
+}
+
+inline CoreResult coreSessionSummary(size_t position, int& present, int& absent, int& late) {
+    lock_guard<mutex> lock(dataMutex);
+    if(position >= sessions.size()) return CORE_NOT_FOUND;
+    // The cached counts of a session whose record is damaged may miss
+    // journaled marks
+    if(sessions[position].isUnreadable()) return CORE_IO_ERROR;
+    sessions[position].getSummary(present, absent, late);
+    return CORE_OK;
+}
+
+// A student's totals over every session
+inline CoreResult coreStudentTotals(const string& indexNumber, AttendanceCounts& counts) {
+    lock_guard<mutex> lock(dataMutex);
+    buildAttendanceCountsLocked();
+    int32_t id = students.findId(toUpperCase(indexNumber));
+    if(id == StudentRegistry::NO_ID || !students.isRegistered(static_cast<uint32_t>(id))) return CORE_NOT_FOUND;
+    counts = students.getCounts(static_cast<uint32_t>(id));
+    return CORE_OK;
+}
+
+// A student picked out by a history query: the length of their longest
+// absence streak, or their marks of the queried status out of all marks
+struct HistoryMatch {
+    string indexNumber;
+    string name;
+    uint32_t count = 0;
+    uint32_t marked = 0;
+};
+
+// Students absent from more than moreThan sessions in a row of course
+// (every session when empty), longest streak first
+inline CoreResult coreAbsenceStreaks(const string& course, uint32_t moreThan, vector<HistoryMatch>& matches) {
+    lock_guard<mutex> lock(dataMutex);
+    buildAttendanceHistoryLocked();
+    string courseCode = toUpperCase(course);
+    const AttendanceHistory& history = students.history();
+    if(!courseCode.empty() && !history.hasCourse(courseCode)) return CORE_NOT_FOUND;
+    matches.clear();
+    for(uint32_t id = 0; id < students.idCount(); id++) {
+        if(!students.isRegistered(id)) continue;
+        uint32_t streak = history.longestAbsence(id, courseCode);
+        if(streak > moreThan) matches.push_back({students[id].getIndexNumber(), students[id].getName(), streak, 0});
+    }
+    stable_sort(matches.begin(), matches.end(), [](const HistoryMatch& a, const HistoryMatch& b) { return a.count > b.count; });
+    return CORE_OK;
+}
+
+// Students with status in more than percent of their marked sessions of
+// course (every session when empty), highest share first
+inline CoreResult coreStatusShares(const string& course, AttendanceStatus status, double percent,
+                                   vector<HistoryMatch>& matches) {
+    lock_guard<mutex> lock(dataMutex);
+    buildAttendanceHistoryLocked();
+    string courseCode = toUpperCase(course);
+    const AttendanceHistory& history = students.history();
+    if(!courseCode.empty() && !history.hasCourse(courseCode)) return CORE_NOT_FOUND;
+    matches.clear();
+    for(uint32_t id = 0; id < students.idCount(); id++) {
+        if(!students.isRegistered(id)) continue;
+        HistoryMatch match{students[id].getIndexNumber(), students[id].getName(), 0, 0};
+        history.statusShare(id, courseCode, status, match.count, match.marked);
+        if(match.marked > 0 && match.count * 100.0 > percent * match.marked) matches.push_back(move(match));
+    }
+    stable_sort(matches.begin(), matches.end(), [](const HistoryMatch& a, const HistoryMatch& b) {
+        return static_cast<uint64_t>(a.count) * b.marked > static_cast<uint64_t>(b.count) * a.marked;
+    });
+    return CORE_OK;
+}
+
+// Memory held by the history index, building it first
+inline HistoryFootprint coreHistoryFootprint() {
+    lock_guard<mutex> lock(dataMutex);
+    buildAttendanceHistoryLocked();
+    return students.history().footprint();
+}
+
+#endif
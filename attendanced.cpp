@@ -0,0 +1,588 @@
+// attendanced: owns the attendance data and serves it to local clients,
+// so several lecturers can mark and query at the same time without
+// overwriting each other's files. It holds the data lock, so the menu
+// program refuses to start next to it.
+//
+//   attendanced [--dir DIR] [--socket PATH] [--tcp PORT] [--load-threads N]
+//
+// Clients connect to a Unix socket (attendanced.sock in the data
+// directory) or, with --tcp, to 127.0.0.1:PORT, and send one request per
+// line. Every request gets exactly one reply line, in request order, so
+// clients may pipeline as many requests as they like:
+//
+//   PING                                   OK PONG
+//   REGISTER INDEX NAME...                 OK
+//   STUDENT INDEX                          OK INDEX NAME...
+//   CREATE COURSE/DATE/TIME DURATION       OK
+//   SESSIONS COURSE|PREFIX* [FROM [TO]]    OK COUNT COURSE/DATE/TIME...
+//   MARK COURSE/DATE/TIME INDEX=S...       OK COUNT      (S is P, A or L)
+//   STATUS COURSE/DATE/TIME INDEX          OK PRESENT|ABSENT|LATE|UNMARKED
+//   SUMMARY COURSE/DATE/TIME               OK PRESENT ABSENT LATE
+//   TOTALS INDEX                           OK ENROLLED PRESENT LATE ABSENT
+//   STREAKS COURSE|* N                     OK COUNT INDEX:STREAK...
+//   SHARES COURSE|* P|A|L PERCENT          OK COUNT INDEX:COUNT/MARKED...
+//   HISTORY                                OK STUDENTS SESSIONS RUNS BYTES PLAIN_BYTES
+//   SAVE                                   OK
+//   SHUTDOWN                               OK, then the daemon saves and exits
+//
+// A failed request is answered "ERR CODE MESSAGE", CODE being the
+// CoreResult. The loop is single-threaded over non-blocking sockets and
+// epoll. Requests read in one pass are batched: MARKs are checked one by
+// one but applied per session, students registered in the pass are saved
+// once, and at the end of the pass the background writer is flushed, so
+// all of the pass's marks, students and sessions reach the disk together
+// before any of their OKs is sent.
+
+#include "attendance_core.h"
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/signalfd.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unordered_map>
+
+// Counts allocations in -DATTENDANCE_STATS builds
+ATTENDANCE_ALLOCATION_COUNTER()
+
+const string DEFAULT_SOCKET = "attendanced.sock";
+const size_t MAX_REQUEST_LINE = 1 << 20;
+const size_t READ_BLOCK = 64 * 1024;
+
+// epoll user data: the signal fd, then the listeners, then connections
+const uint64_t SIGNAL_ID = 0;
+const uint64_t FIRST_CONNECTION_ID = 1024;
+
+// One client: bytes read but not yet parsed, and replies not yet sent
+struct Connection {
+    int fd = -1;
+    string input;
+    string output;
+    size_t outputSent = 0;
+    bool peerClosed = false; // the client shut down its side
+    bool failed = false;     // a socket error; drop without writing
+    bool closing = false;    // close once the output is sent
+    bool wantsWrite = false; // EPOLLOUT is armed
+};
+
+// A reply in request order. MARK, REGISTER and CREATE replies are final
+// only after the pass's writes are flushed.
+struct PendingReply {
+    uint64_t connection;
+    string text;
+    int markBatch;     // index into markBatches, or -1
+    bool awaitsSave;   // confirmed by the flush at the end of the pass
+};
+
+// Checked marks for one session, committed with one coreMarkAttendance
+struct MarkBatch {
+    size_t position;
+    vector<pair<string, AttendanceStatus>> marks;
+};
+
+string errorReply(CoreResult result) {
+    return "ERR " + to_string(static_cast<int>(result)) + " " + coreResultMessage(result);
+}
+
+string sessionSpec(const AttendanceSession& session) {
+    return session.getCourseCode() + "/" + session.getDate() + "/" + session.getStartTime();
+}
+
+// Split a request into words; runs of spaces and tabs separate them
+size_t splitWords(string_view line, vector<string_view>& words) {
+    words.clear();
+    size_t pos = 0;
+    while(pos < line.size()) {
+        while(pos < line.size() && (line[pos] == ' ' || line[pos] == '\t')) pos++;
+        size_t start = pos;
+        while(pos < line.size() && line[pos] != ' ' && line[pos] != '\t') pos++;
+        if(pos > start) words.push_back(line.substr(start, pos - start));
+    }
+    return words.size();
+}
+
+// COURSE/YYYY-MM-DD/HH:MM -> position in sessions
+CoreResult findSession(string_view spec, size_t& position) {
+    string_view parts[3];
+    if(splitFields(spec, '/', parts, 3) != 3) return CORE_INVALID_ARGUMENT;
+    return coreFindSession(string(parts[0]), string(parts[1]), string(parts[2]), position);
+}
+
+class AttendanceDaemon {
+private:
+    int epollFd = -1;
+    int signalFd = -1;
+    vector<int> listeners;
+    vector<string> socketPaths;
+    unordered_map<uint64_t, Connection> connections;
+    uint64_t nextConnectionId = FIRST_CONNECTION_ID;
+    
+    vector<PendingReply> pending;
+    vector<MarkBatch> markBatches;
+    bool registeredStudents = false;
+    bool stopping = false;
+    
+    bool watch(int fd, uint64_t id, uint32_t events, int operation = EPOLL_CTL_ADD) {
+        epoll_event event;
+        event.events = events;
+        event.data.u64 = id;
+        return epoll_ctl(epollFd, operation, fd, &event) == 0;
+    }
+    
+    bool addListener(int fd) {
+        if(listen(fd, SOMAXCONN) != 0 || !watch(fd, 1 + listeners.size(), EPOLLIN)) {
+            ::close(fd);
+            return false;
+        }
+        listeners.push_back(fd);
+        return true;
+    }
+    
+    void acceptClients(int listener) {
+        while(true) {
+            int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if(fd < 0) return; // EAGAIN once the backlog is empty
+            uint64_t id = nextConnectionId++;
+            if(!watch(fd, id, EPOLLIN | EPOLLRDHUP)) {
+                ::close(fd);
+                continue;
+            }
+            connections[id].fd = fd;
+        }
+    }
+    
+    // Read everything available and handle each complete line
+    void readFrom(uint64_t id, Connection& conn) {
+        char block[READ_BLOCK];
+        while(true) {
+            ssize_t got = read(conn.fd, block, sizeof(block));
+            if(got > 0) {
+                conn.input.append(block, static_cast<size_t>(got));
+                continue;
+            }
+            if(got == 0) conn.peerClosed = true;
+            else if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) conn.failed = true;
+            if(got < 0 && errno == EINTR) continue;
+            break;
+        }
+        
+        size_t start = 0;
+        size_t newline;
+        while(!conn.closing && (newline = conn.input.find('\n', start)) != string::npos) {
+            string_view line(conn.input.data() + start, newline - start);
+            if(!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            handleRequest(id, line);
+            start = newline + 1;
+        }
+        conn.input.erase(0, start);
+        if(conn.input.size() > MAX_REQUEST_LINE) {
+            pending.push_back({id, errorReply(CORE_INVALID_ARGUMENT) + " (request line too long)", -1, false});
+            conn.input.clear();
+            conn.closing = true;
+        }
+        if(conn.peerClosed) conn.closing = true;
+    }
+    
+    void reply(uint64_t id, string text) {
+        pending.push_back({id, move(text), -1, false});
+    }
+    
+    void handleRequest(uint64_t id, string_view line) {
+        vector<string_view> words;
+        if(splitWords(line, words) == 0) return;
+        string command = toUpperCase(string(words[0]));
+        
+        // Anything but a MARK must see the marks before it
+        if(command != "MARK") commitMarks();
+        
+        if(command == "PING") {
+            reply(id, "OK PONG");
+        } else if(command == "REGISTER" && words.size() >= 3) {
+            size_t nameStart = words[2].data() - line.data();
+            CoreResult result = coreRegisterStudent(string(words[1]), string(line.substr(nameStart)));
+            if(result != CORE_OK) {
+                reply(id, errorReply(result));
+                return;
+            }
+            registeredStudents = true;
+            pending.push_back({id, "OK", -1, true});
+        } else if(command == "STUDENT" && words.size() == 2) {
+            Student student;
+            CoreResult result = coreFindStudent(string(words[1]), student);
+            reply(id, result == CORE_OK ? "OK " + student.getIndexNumber() + " " + student.getName() : errorReply(result));
+        } else if(command == "CREATE" && words.size() == 3) {
+            string_view parts[3];
+            if(splitFields(words[1], '/', parts, 3) != 3) {
+                reply(id, errorReply(CORE_INVALID_ARGUMENT));
+                return;
+            }
+            CoreResult result = coreCreateSession(string(parts[0]), string(parts[1]), string(parts[2]), string(words[2]));
+            if(result != CORE_OK) reply(id, errorReply(result));
+            else pending.push_back({id, "OK", -1, true});
+        } else if(command == "SESSIONS" && words.size() >= 2 && words.size() <= 4) {
+            string course(words[1]);
+            bool prefix = course.back() == '*';
+            if(prefix) course.pop_back();
+            string fromDate = words.size() > 2 ? string(words[2]) : "";
+            string toDate = words.size() > 3 ? string(words[3]) : (words.size() > 2 ? fromDate : "");
+            vector<size_t> matches = coreQuerySessions(course, prefix, fromDate, toDate);
+            string text = "OK " + to_string(matches.size());
+            for(size_t position : matches) {
+                text += " " + sessionSpec(sessions[position]);
+            }
+            reply(id, text);
+        } else if(command == "MARK" && words.size() >= 3) {
+            queueMarks(id, words);
+        } else if(command == "STATUS" && words.size() == 3) {
+            size_t position;
+            AttendanceStatus status;
+            bool marked;
+            CoreResult result = findSession(words[1], position);
+            if(result == CORE_OK) result = coreStudentStatus(position, string(words[2]), status, marked);
+            if(result != CORE_OK) reply(id, errorReply(result));
+            else reply(id, "OK " + (marked ? statusToString(status) : string("UNMARKED")));
+        } else if(command == "SUMMARY" && words.size() == 2) {
+            size_t position;
+            int p, a, l;
+            CoreResult result = findSession(words[1], position);
+            if(result == CORE_OK) result = coreSessionSummary(position, p, a, l);
+            if(result != CORE_OK) reply(id, errorReply(result));
+            else reply(id, "OK " + to_string(p) + " " + to_string(a) + " " + to_string(l));
+        } else if(command == "TOTALS" && words.size() == 2) {
+            AttendanceCounts counts;
+            CoreResult result = coreStudentTotals(string(words[1]), counts);
+            if(result != CORE_OK) reply(id, errorReply(result));
+            else reply(id, "OK " + to_string(counts.enrolled) + " " + to_string(counts.present) + " "
+                           + to_string(counts.late) + " " + to_string(counts.absent));
+        } else if(command == "STREAKS" && words.size() == 3) {
+            // Absent from more than N sessions in a row
+            uint32_t moreThan;
+            vector<HistoryMatch> matches;
+            CoreResult result = parseNumber(words[2], moreThan) ? CORE_OK : CORE_INVALID_ARGUMENT;
+            if(result == CORE_OK) result = coreAbsenceStreaks(words[1] == "*" ? "" : string(words[1]), moreThan, matches);
+            if(result != CORE_OK) {
+                reply(id, errorReply(result));
+                return;
+            }
+            string text = "OK " + to_string(matches.size());
+            for(const auto& match : matches) {
+                text += " " + match.indexNumber + ":" + to_string(match.count);
+            }
+            reply(id, text);
+        } else if(command == "SHARES" && words.size() == 4) {
+            // PRESENT, ABSENT or LATE in more than PERCENT of the sessions
+            uint32_t percent;
+            vector<HistoryMatch> matches;
+            string status = toUpperCase(string(words[2]));
+            CoreResult result = status.size() == 1 && string("PAL").find(status[0]) != string::npos
+                                && parseNumber(words[3], percent) ? CORE_OK : CORE_INVALID_ARGUMENT;
+            if(result == CORE_OK) {
+                result = coreStatusShares(words[1] == "*" ? "" : string(words[1]), charToStatus(status[0]), percent, matches);
+            }
+            if(result != CORE_OK) {
+                reply(id, errorReply(result));
+                return;
+            }
+            string text = "OK " + to_string(matches.size());
+            for(const auto& match : matches) {
+                text += " " + match.indexNumber + ":" + to_string(match.count) + "/" + to_string(match.marked);
+            }
+            reply(id, text);
+        } else if(command == "HISTORY" && words.size() == 1) {
+            HistoryFootprint f = coreHistoryFootprint();
+            reply(id, "OK " + to_string(f.students) + " " + to_string(f.columns) + " " + to_string(f.runs) + " "
+                      + to_string(f.bytes) + " " + to_string(f.plainBytes));
+        } else if(command == "SAVE" && words.size() == 1) {
+            CoreResult saved = coreSave();
+            CoreResult result = coreFlush();
+            if(result == CORE_OK) result = saved;
+            registeredStudents = false;
+            reply(id, result == CORE_OK ? "OK" : errorReply(result));
+        } else if(command == "SHUTDOWN" && words.size() == 1) {
+            reply(id, "OK");
+            stopping = true;
+        } else {
+            reply(id, errorReply(CORE_INVALID_ARGUMENT) + " (unknown command or wrong arguments)");
+        }
+    }
+    
+    // Check a MARK now and hold it for its session's batch
+    void queueMarks(uint64_t id, const vector<string_view>& words) {
+        size_t position;
+        CoreResult result = findSession(words[1], position);
+        if(result != CORE_OK) {
+            reply(id, errorReply(result));
+            return;
+        }
+        vector<pair<string, AttendanceStatus>> marks;
+        for(size_t i = 2; i < words.size(); i++) {
+            size_t equals = words[i].find('=');
+            if(equals == string_view::npos || equals + 2 != words[i].size() || !isValidStatusChar(words[i][equals + 1])) {
+                reply(id, errorReply(CORE_INVALID_ARGUMENT) + " (marks are INDEX=P, INDEX=A or INDEX=L)");
+                return;
+            }
+            marks.push_back({toUpperCase(string(words[i].substr(0, equals))), charToStatus(words[i][equals + 1])});
+        }
+        result = coreCheckMarks(position, marks);
+        if(result != CORE_OK) {
+            reply(id, errorReply(result));
+            return;
+        }
+        
+        size_t batch = 0;
+        while(batch < markBatches.size() && markBatches[batch].position != position) batch++;
+        if(batch == markBatches.size()) markBatches.push_back({position, {}});
+        vector<pair<string, AttendanceStatus>>& queued = markBatches[batch].marks;
+        queued.insert(queued.end(), make_move_iterator(marks.begin()), make_move_iterator(marks.end()));
+        pending.push_back({id, "OK " + to_string(words.size() - 2), static_cast<int>(batch), true});
+    }
+    
+    // Apply the queued marks, one batch per session, and settle the
+    // replies of any that could not be
+    void commitMarks() {
+        for(size_t batch = 0; batch < markBatches.size(); batch++) {
+            CoreResult result = coreMarkAttendance(markBatches[batch].position, markBatches[batch].marks);
+            for(auto& entry : pending) {
+                if(entry.markBatch == static_cast<int>(batch)) {
+                    if(result != CORE_OK) entry.text = errorReply(result);
+                    entry.markBatch = -1;
+                }
+            }
+        }
+        markBatches.clear();
+    }
+    
+    // End of a pass: apply the marks, save new students once, wait for
+    // the writer (one journal write for every mark of the pass) and queue
+    // the replies
+    void settleReplies() {
+        commitMarks();
+        if(registeredStudents) {
+            coreSave();
+            registeredStudents = false;
+        }
+        CoreResult result = coreFlush();
+        if(result != CORE_OK) {
+            for(auto& entry : pending) {
+                if(entry.awaitsSave && entry.text.compare(0, 3, "ERR") != 0) entry.text = errorReply(result);
+            }
+        }
+        for(auto& entry : pending) {
+            auto it = connections.find(entry.connection);
+            if(it == connections.end() || it->second.failed) continue;
+            it->second.output += entry.text;
+            it->second.output += '\n';
+        }
+        pending.clear();
+    }
+    
+    void writeTo(uint64_t id, Connection& conn) {
+        while(conn.outputSent < conn.output.size()) {
+            ssize_t sent = send(conn.fd, conn.output.data() + conn.outputSent, conn.output.size() - conn.outputSent, MSG_NOSIGNAL);
+            if(sent > 0) {
+                conn.outputSent += static_cast<size_t>(sent);
+            } else if(sent < 0 && errno == EINTR) {
+                continue;
+            } else if(sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            } else {
+                conn.failed = true;
+                return;
+            }
+        }
+        if(conn.outputSent == conn.output.size()) {
+            conn.output.clear();
+            conn.outputSent = 0;
+        }
+        bool wantsWrite = !conn.output.empty();
+        if(wantsWrite != conn.wantsWrite) {
+            watch(conn.fd, id, EPOLLIN | EPOLLRDHUP | (wantsWrite ? static_cast<uint32_t>(EPOLLOUT) : 0u), EPOLL_CTL_MOD);
+            conn.wantsWrite = wantsWrite;
+        }
+    }
+    
+    void flushConnections() {
+        for(auto it = connections.begin(); it != connections.end();) {
+            Connection& conn = it->second;
+            if(!conn.failed && !conn.output.empty()) writeTo(it->first, conn);
+            if(conn.failed || (conn.closing && conn.output.empty())) {
+                epoll_ctl(epollFd, EPOLL_CTL_DEL, conn.fd, nullptr);
+                ::close(conn.fd);
+                it = connections.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    
+    // Send what is still queued once the loop has stopped, the reply to
+    // SHUTDOWN among it. Clients that do not read get a few seconds.
+    void drainOutput() {
+        auto deadline = chrono::steady_clock::now() + chrono::seconds(5);
+        while(true) {
+            flushConnections();
+            vector<pollfd> waiting;
+            for(const auto& entry : connections) {
+                if(!entry.second.failed && !entry.second.output.empty()) waiting.push_back({entry.second.fd, POLLOUT, 0});
+            }
+            auto left = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count();
+            if(waiting.empty() || left <= 0) return;
+            if(poll(waiting.data(), waiting.size(), static_cast<int>(left)) < 0 && errno != EINTR) return;
+        }
+    }
+
+public:
+    ~AttendanceDaemon() {
+        for(auto& entry : connections) ::close(entry.second.fd);
+        for(int fd : listeners) ::close(fd);
+        for(const auto& path : socketPaths) unlink(path.c_str());
+        if(signalFd >= 0) ::close(signalFd);
+        if(epollFd >= 0) ::close(epollFd);
+    }
+    
+    // SIGINT and SIGTERM stop the daemon (and, with statistics, SIGUSR1
+    // dumps them); they arrive through a signalfd in the loop
+    bool start() {
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if(epollFd < 0) return false;
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+#ifdef ATTENDANCE_STATS
+        sigaddset(&signals, SIGUSR1);
+#endif
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+        signalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+        return signalFd >= 0 && watch(signalFd, SIGNAL_ID, EPOLLIN);
+    }
+    
+    // The data lock is held, so a socket file left behind is stale
+    bool listenUnix(const string& path) {
+        sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if(path.size() >= sizeof(address.sun_path)) return false;
+        memcpy(address.sun_path, path.c_str(), path.size());
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if(fd < 0) return false;
+        unlink(path.c_str());
+        if(bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            ::close(fd);
+            return false;
+        }
+        socketPaths.push_back(path);
+        return addListener(fd);
+    }
+    
+    bool listenTcp(int port) {
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<uint16_t>(port));
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if(fd < 0) return false;
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if(bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            ::close(fd);
+            return false;
+        }
+        return addListener(fd);
+    }
+    
+    void run() {
+        const int MAX_EVENTS = 64;
+        epoll_event events[MAX_EVENTS];
+        while(!stopping) {
+            int count = epoll_wait(epollFd, events, MAX_EVENTS, -1);
+            if(count < 0) {
+                if(errno == EINTR) continue;
+                cout << "✗ Error: epoll_wait failed: " << strerror(errno) << endl;
+                break;
+            }
+            for(int i = 0; i < count; i++) {
+                uint64_t id = events[i].data.u64;
+                if(id == SIGNAL_ID) {
+                    signalfd_siginfo info;
+                    while(read(signalFd, &info, sizeof(info)) == sizeof(info)) {
+#ifdef ATTENDANCE_STATS
+                        if(info.ssi_signo == SIGUSR1) {
+                            writeStatsFile(STATS_FILE);
+                            continue;
+                        }
+#endif
+                        stopping = true;
+                    }
+                } else if(id < FIRST_CONNECTION_ID) {
+                    acceptClients(listeners[id - 1]);
+                } else {
+                    auto it = connections.find(id);
+                    if(it == connections.end()) continue;
+                    // EPOLLOUT needs nothing here: flushConnections sends the rest
+                    if(events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) readFrom(id, it->second);
+                }
+            }
+            settleReplies();
+            flushConnections();
+        }
+        drainOutput();
+    }
+};
+
+int main(int argc, char* argv[]) {
+    string dir, socketPath = DEFAULT_SOCKET;
+    int tcpPort = 0;
+    for(int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if(arg == "--dir" && i + 1 < argc) dir = argv[++i];
+        else if(arg == "--socket" && i + 1 < argc) socketPath = argv[++i];
+        else if(arg == "--tcp" && i + 1 < argc && parseNumber(argv[i + 1], tcpPort) && tcpPort > 0 && tcpPort < 65536) i++;
+        else if(arg == "--load-threads" && i + 1 < argc && parseNumber(argv[i + 1], loadThreads)) i++;
+        else {
+            cout << "Usage: " << argv[0] << " [--dir DIR] [--socket PATH] [--tcp PORT] [--load-threads N]\n";
+            return 2;
+        }
+    }
+    if(!dir.empty() && chdir(dir.c_str()) != 0) {
+        cout << "✗ Error: Could not use directory " << dir << endl;
+        return 1;
+    }
+    
+    AttendanceDaemon daemon;
+    if(!daemon.start()) {
+        cout << "✗ Error: Could not set up the event loop: " << strerror(errno) << endl;
+        return 1;
+    }
+    CoreResult opened = coreOpen();
+    if(opened != CORE_OK) {
+        cout << "✗ Error: " << coreResultMessage(opened) << endl;
+        if(opened != CORE_LOCKED) compactor.stop();
+        return 1;
+    }
+    if(!daemon.listenUnix(socketPath)) {
+        cout << "✗ Error: Could not listen on " << socketPath << ": " << strerror(errno) << endl;
+        coreClose();
+        return 1;
+    }
+    if(tcpPort > 0 && !daemon.listenTcp(tcpPort)) {
+        cout << "✗ Error: Could not listen on 127.0.0.1:" << tcpPort << ": " << strerror(errno) << endl;
+        coreClose();
+        return 1;
+    }
+    cout << "✓ attendanced serving " << students.size() << " students and " << sessions.size() << " sessions on "
+         << socketPath;
+    if(tcpPort > 0) cout << " and 127.0.0.1:" << tcpPort;
+    cout << endl;
+    
+    daemon.run();
+    
+    cout << "Shutting down.\n";
+    CoreResult closed = coreClose();
+    if(closed != CORE_OK) cout << "✗ Error: Some changes could not be written to disk.\n";
+#ifdef ATTENDANCE_STATS
+    writeStatsFile(STATS_FILE);
+#endif
+    return closed == CORE_OK ? 0 : 1;
+}
@@ -0,0 +1,277 @@
+// Batched positional reads and writes shared by the attendance programs.
+// Callers queue every read or write of a mass load or save and run them
+// together. Built with -DATTENDANCE_USE_IO_URING the batch is submitted
+// through an io_uring, a few hundred operations per system call;
+// otherwise, or when the kernel refuses to set up a ring (old kernel,
+// seccomp), each operation is a blocking pread/pwrite as before.
+//
+// The ring is set up with the raw system calls from <linux/io_uring.h>,
+// so no liburing is needed. It stays off unless ATTENDANCE_IO_URING is
+// set (to anything but 0) in the environment.
+
+#ifndef BATCH_IO_H
+#define BATCH_IO_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+#ifdef ATTENDANCE_USE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+// <linux/fs.h>, pulled in above, defines these as macros
+#undef BLOCK_SIZE
+#undef BLOCK_SIZE_BITS
+#endif
+
+// System calls issued by batches, for benchmarks
+inline std::atomic<unsigned long> batchIoSyscalls(0);
+
+// Whether batches may use io_uring; ATTENDANCE_IO_URING=1 sets it and a
+// benchmark may switch it to compare both paths
+inline std::atomic<bool> batchIoUseRing(std::getenv("ATTENDANCE_IO_URING") != nullptr
+                                        && std::strcmp(std::getenv("ATTENDANCE_IO_URING"), "0") != 0);
+
+#ifdef ATTENDANCE_USE_IO_URING
+// Minimal io_uring: one submission and one completion ring, mapped
+// separately so setup also works before IORING_FEAT_SINGLE_MMAP (5.4).
+// Kernels before 5.6 set the ring up but fail IORING_OP_READ/WRITE with
+// -EINVAL; run() then redoes those operations with blocking calls and
+// stops using the ring.
+class IoRing {
+private:
+    int fd = -1;
+    bool refused = false; // the kernel rejected our opcodes
+    unsigned depth = 0;
+    char* sqRing = nullptr;
+    char* cqRing = nullptr;
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqesSize = 0;
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned* sqMask = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned* cqMask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+
+public:
+    explicit IoRing(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if(fd < 0) return;
+        depth = params.sq_entries;
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void* sq = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        void* cq = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        void* s = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if(sq == MAP_FAILED || cq == MAP_FAILED || s == MAP_FAILED) {
+            if(sq != MAP_FAILED) munmap(sq, sqRingSize);
+            if(cq != MAP_FAILED) munmap(cq, cqRingSize);
+            if(s != MAP_FAILED) munmap(s, sqesSize);
+            ::close(fd);
+            fd = -1;
+            return;
+        }
+        sqRing = static_cast<char*>(sq);
+        cqRing = static_cast<char*>(cq);
+        sqes = static_cast<io_uring_sqe*>(s);
+        sqHead = reinterpret_cast<unsigned*>(sqRing + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned*>(sqRing + params.sq_off.tail);
+        sqMask = reinterpret_cast<unsigned*>(sqRing + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sqRing + params.sq_off.array);
+        cqHead = reinterpret_cast<unsigned*>(cqRing + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cqRing + params.cq_off.tail);
+        cqMask = reinterpret_cast<unsigned*>(cqRing + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cqRing + params.cq_off.cqes);
+    }
+
+    ~IoRing() {
+        if(fd < 0) return;
+        munmap(sqes, sqesSize);
+        munmap(cqRing, cqRingSize);
+        munmap(sqRing, sqRingSize);
+        ::close(fd);
+    }
+
+    IoRing(const IoRing&) = delete;
+    IoRing& operator=(const IoRing&) = delete;
+
+    bool usable() const { return fd >= 0 && !refused; }
+    unsigned capacity() const { return depth; }
+    void refuse() { refused = true; }
+
+    // Queue one read or write; at most capacity() between waits
+    void prepare(bool write, int file, void* data, unsigned size, uint64_t offset, uint64_t tag) {
+        unsigned tail = *sqTail;
+        unsigned index = tail & *sqMask;
+        io_uring_sqe& sqe = sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+        sqe.fd = file;
+        sqe.off = offset;
+        sqe.addr = reinterpret_cast<uint64_t>(data);
+        sqe.len = size;
+        sqe.user_data = tag;
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    }
+
+    // Submit what was prepared and wait for all of it; done(tag, result)
+    // is called per completion. False if the kernel refused part of the
+    // batch: whatever it had taken is still waited for, so its buffers are
+    // free again, and the rest is withdrawn without a completion.
+    template<typename Done>
+    bool submitAndWait(unsigned count, Done done) {
+        unsigned submitted = 0;
+        unsigned completed = 0;
+        bool failed = false;
+        while(completed < (failed ? submitted : count)) {
+            unsigned toSubmit = failed ? 0 : count - submitted;
+            unsigned toWait = (failed ? submitted : count) - completed;
+            int entered = static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, toWait,
+                                                   IORING_ENTER_GETEVENTS, nullptr, 0));
+            batchIoSyscalls++;
+            if(entered < 0) {
+                if(errno == EINTR) continue;
+                // Only waiting is left to do and that cannot be skipped
+                if(failed && (errno == EAGAIN || errno == EBUSY)) continue;
+                if(failed) break;
+                failed = true;
+                continue;
+            }
+            submitted += static_cast<unsigned>(entered);
+            unsigned head = *cqHead;
+            unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+            while(head != tail) {
+                const io_uring_cqe& cqe = cqes[head & *cqMask];
+                done(cqe.user_data, cqe.res);
+                head++;
+                completed++;
+            }
+            __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        }
+        if(failed) {
+            // Entries the kernel never consumed would go out with the next
+            // batch; move the tail back over them
+            __atomic_store_n(sqTail, __atomic_load_n(sqHead, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+        }
+        return !failed;
+    }
+};
+
+// One ring per thread, set up on first use
+inline IoRing* threadRing() {
+    if(!batchIoUseRing) return nullptr;
+    thread_local IoRing ring(256);
+    return ring.usable() ? &ring : nullptr;
+}
+#endif
+
+// Reads and writes queued for one run(). The buffers must stay valid and
+// unchanged until run() returns.
+class BatchIo {
+private:
+    struct Op {
+        int fd;
+        bool write;
+        char* data;
+        size_t size;
+        uint64_t offset;
+        bool ok;
+        bool finished; // completed through the ring, successfully or not
+    };
+    std::vector<Op> ops;
+
+    // Finish an operation (or the rest of a short one) with blocking calls
+    static bool runBlocking(Op& op, size_t done) {
+        while(done < op.size) {
+            ssize_t n = op.write ? ::pwrite(op.fd, op.data + done, op.size - done, static_cast<off_t>(op.offset + done))
+                                 : ::pread(op.fd, op.data + done, op.size - done, static_cast<off_t>(op.offset + done));
+            batchIoSyscalls++;
+            if(n < 0 && errno == EINTR) continue;
+            if(n <= 0) return false;
+            done += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+public:
+    void read(int fd, char* data, size_t size, uint64_t offset) {
+        ops.push_back({fd, false, data, size, offset, false, false});
+    }
+
+    void write(int fd, const char* data, size_t size, uint64_t offset) {
+        ops.push_back({fd, true, const_cast<char*>(data), size, offset, false, false});
+    }
+
+    size_t size() const { return ops.size(); }
+    bool ok(size_t i) const { return ops[i].ok; }
+    void clear() { ops.clear(); }
+
+    // Name of the backend run() will use on this thread
+    static const char* backend() {
+#ifdef ATTENDANCE_USE_IO_URING
+        if(threadRing() != nullptr) return "io_uring";
+#endif
+        return "blocking";
+    }
+
+    // Run every queued operation; true if all of them completed. ok(i)
+    // tells which did.
+    bool run() {
+        size_t next = 0;
+        for(Op& op : ops) op.finished = false;
+#ifdef ATTENDANCE_USE_IO_URING
+        IoRing* ring = threadRing();
+        while(ring != nullptr && next < ops.size()) {
+            unsigned count = 0;
+            for(size_t i = next; i < ops.size() && count < ring->capacity(); i++, count++) {
+                Op& op = ops[i];
+                // Sizes past what one request can carry go the blocking way
+                unsigned size = op.size > (1u << 30) ? 0 : static_cast<unsigned>(op.size);
+                ring->prepare(op.write, op.fd, op.data, size, op.offset, i);
+            }
+            bool submitted = ring->submitAndWait(count, [&](uint64_t tag, int result) {
+                Op& op = ops[tag];
+                op.finished = true;
+                if(result == -EIO) {
+                    op.ok = false;
+                } else if(result < 0) {
+                    // Not a failure of the file itself: an opcode the
+                    // kernel lacks, a request it could not take. The
+                    // blocking call gives the real answer.
+                    if(result == -EINVAL || result == -EOPNOTSUPP) ring->refuse();
+                    op.ok = runBlocking(op, 0);
+                } else {
+                    size_t done = static_cast<size_t>(result);
+                    op.ok = done == op.size || runBlocking(op, done);
+                }
+            });
+            if(!submitted) break;
+            next += count;
+            if(!ring->usable()) break;
+        }
+#endif
+        bool all = true;
+        for(size_t i = 0; i < ops.size(); i++) {
+            if(i >= next && !ops[i].finished) ops[i].ok = runBlocking(ops[i], 0);
+            all = all && ops[i].ok;
+        }
+        return all;
+    }
+};
+
+#endif
@@ -0,0 +1,328 @@
+// Crash-safe file replacement shared by the attendance programs.
+// A file is never overwritten in place: its new contents go to a
+// temporary file next to it, which is synced and then renamed over the
+// old one, so after a crash or power loss the file holds either the old
+// or the new contents, never a mix. Several files can be staged and
+// committed together; their data syncs are issued back to back and the
+// directory, where the renames live, is synced once for all of them
+// (group commit). Overwrites of live data in place go through a
+// double-write buffer instead, so a torn write can be repaired.
+//
+// For testing, ATTENDANCE_FAULT_AFTER_FILES=N kills the process with
+// SIGKILL once N file steps (writing a temporary file, or a rename) have
+// completed, just before the next one, i.e. in the middle of a save.
+
+#ifndef DURABLE_WRITE_H
+#define DURABLE_WRITE_H
+
+#include <string>
+#include <vector>
+#include <array>
+#include <map>
+#include <utility>
+#include <cstdint>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// File steps started by this process; a test resets it after fork()
+inline long durableStepsDone = 0;
+
+// Called before each file step; kills the process at the configured one
+inline void durableFaultPoint() {
+    const char* value = std::getenv("ATTENDANCE_FAULT_AFTER_FILES");
+    if(value == nullptr || *value == '\0') return;
+    if(durableStepsDone++ == std::atol(value)) {
+        kill(getpid(), SIGKILL);
+    }
+}
+
+// Write all of data to fd; false on error
+inline bool writeFully(int fd, const char* data, size_t size) {
+    while(size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if(written < 0 && errno == EINTR) continue;
+        if(written <= 0) return false;
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+// Directory holding filename, for syncDirectory
+inline std::string parentDirectory(const std::string& filename) {
+    size_t slash = filename.rfind('/');
+    if(slash == std::string::npos) return ".";
+    return slash == 0 ? "/" : filename.substr(0, slash);
+}
+
+// Make the directory entries of a directory (created, renamed files) durable
+inline bool syncDirectory(const std::string& directory) {
+    int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(fd < 0) return false;
+    bool synced = ::fsync(fd) == 0;
+    ::close(fd);
+    return synced;
+}
+
+// Files staged for one atomic, durable save
+class GroupCommit {
+private:
+    struct Staged {
+        std::string filename;
+        std::string tempName;
+        std::string contents;
+        int fd = -1;
+    };
+    std::vector<Staged> files;
+    std::string lastError;
+
+    bool fail(const std::string& message) {
+        lastError = message + ": " + std::strerror(errno);
+        for(auto& file : files) {
+            if(file.fd >= 0) ::close(file.fd);
+            if(!file.tempName.empty()) ::unlink(file.tempName.c_str());
+        }
+        files.clear();
+        return false;
+    }
+
+public:
+    ~GroupCommit() {
+        for(auto& file : files) {
+            if(file.fd >= 0) ::close(file.fd);
+        }
+    }
+
+    // Stage the complete new contents of a file
+    void replace(const std::string& filename, std::string contents) {
+        Staged file;
+        file.filename = filename;
+        file.contents = std::move(contents);
+        files.push_back(std::move(file));
+    }
+
+    size_t size() const { return files.size(); }
+    const std::string& error() const { return lastError; }
+
+    // Write every staged file to a temporary, sync them all, rename each
+    // over its target and sync each directory involved once. On failure
+    // the targets that were not yet renamed keep their old contents.
+    bool commit() {
+        if(files.empty()) return true;
+        std::string suffix = ".tmp" + std::to_string(getpid());
+        for(auto& file : files) {
+            durableFaultPoint();
+            file.tempName = file.filename + suffix;
+            file.fd = ::open(file.tempName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if(file.fd < 0) return fail("could not create " + file.tempName);
+            if(!writeFully(file.fd, file.contents.data(), file.contents.size())) {
+                return fail("could not write " + file.tempName);
+            }
+            std::string().swap(file.contents);
+#ifdef SYNC_FILE_RANGE_WRITE
+            // Start writeback now so the syncs below overlap
+            sync_file_range(file.fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+#endif
+        }
+        for(auto& file : files) {
+            if(::fdatasync(file.fd) != 0) return fail("could not sync " + file.tempName);
+            ::close(file.fd);
+            file.fd = -1;
+        }
+        std::vector<std::string> directories;
+        for(auto& file : files) {
+            durableFaultPoint();
+            if(::rename(file.tempName.c_str(), file.filename.c_str()) != 0) {
+                return fail("could not rename " + file.tempName);
+            }
+            file.tempName.clear();
+            std::string directory = parentDirectory(file.filename);
+            bool seen = false;
+            for(const auto& d : directories) seen = seen || d == directory;
+            if(!seen) directories.push_back(directory);
+        }
+        files.clear();
+        for(const auto& directory : directories) {
+            if(!syncDirectory(directory)) {
+                lastError = "could not sync directory " + directory + ": " + std::strerror(errno);
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// CRC-32 (IEEE) used to checksum journal records, session records and
+// staged overwrites. Pass the CRC of the bytes before data as crc to
+// continue it over several pieces.
+inline uint32_t crc32(const char* data, size_t length, uint32_t crc = 0) {
+    // Built by the first caller; the initialisation of a local static is
+    // thread-safe, and the writer, compactor and main thread all get here
+    static const std::array<uint32_t, 256> table = []() {
+        std::array<uint32_t, 256> t{};
+        for(uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for(int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for(size_t i = 0; i < length; i++) {
+        crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+// Overwrites of live data in place, made safe against torn writes. The
+// new bytes of every overwrite in a batch are first written with a
+// checksum to a side file, which is synced; only then does the owner
+// write them in place and sync its files, and finish() empties the side
+// file. After a crash recover() finds a complete side file and writes its
+// bytes in place again; a torn side file means no in-place write had
+// started yet, so it is ignored. Writes to the same place in one batch
+// keep only the latest bytes.
+class DoubleWriteBuffer {
+public:
+    struct Write {
+        int target;      // index into the file descriptors given to recover()
+        uint64_t offset;
+        std::string data;
+    };
+
+private:
+    struct FileHeader {
+        char magic[4];
+        uint32_t count;
+        uint64_t bodyBytes;
+        uint32_t checksum;
+        uint32_t reserved;
+    };
+    struct WriteHeader {
+        uint32_t target;
+        uint32_t reserved;
+        uint64_t offset;
+        uint64_t size;
+    };
+    static constexpr char MAGIC[4] = { 'A', 'T', 'D', 'W' };
+
+    int fd = -1;
+    std::vector<Write> writes;
+    std::map<std::pair<int, uint64_t>, size_t> writeAt; // (target, offset) -> writes index
+
+public:
+    ~DoubleWriteBuffer() { close(); }
+
+    // Open (creating if needed) the side file; a new one is made durable
+    bool open(const std::string& filename) {
+        close();
+        bool existed = ::access(filename.c_str(), F_OK) == 0;
+        fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if(fd < 0) return false;
+        return existed || (::fdatasync(fd) == 0 && syncDirectory(parentDirectory(filename)));
+    }
+
+    void close() {
+        if(fd >= 0) ::close(fd);
+        fd = -1;
+        writes.clear();
+        writeAt.clear();
+    }
+
+    void add(int target, uint64_t offset, const char* data, size_t size) {
+        auto found = writeAt.find({target, offset});
+        if(found != writeAt.end() && writes[found->second].data.size() == size) {
+            writes[found->second].data.assign(data, size);
+            return;
+        }
+        writeAt[{target, offset}] = writes.size();
+        writes.push_back({target, offset, std::string(data, size)});
+    }
+
+    bool empty() const { return writes.empty(); }
+    const std::vector<Write>& pending() const { return writes; }
+
+    // Write the batch to the side file and sync it; the owner may then
+    // write pending() in place
+    bool stage() {
+        std::string body;
+        for(const auto& write : writes) {
+            WriteHeader w = { static_cast<uint32_t>(write.target), 0, write.offset, write.data.size() };
+            body.append(reinterpret_cast<const char*>(&w), sizeof(w));
+            body += write.data;
+        }
+        FileHeader header;
+        std::memcpy(header.magic, MAGIC, 4);
+        header.count = static_cast<uint32_t>(writes.size());
+        header.bodyBytes = body.size();
+        header.checksum = crc32(body.data(), body.size());
+        header.reserved = 0;
+        body.insert(0, reinterpret_cast<const char*>(&header), sizeof(header));
+        durableFaultPoint();
+        return ::pwrite(fd, body.data(), body.size(), 0) == static_cast<ssize_t>(body.size())
+            && ::ftruncate(fd, static_cast<off_t>(body.size())) == 0 && ::fdatasync(fd) == 0;
+    }
+
+    // The in-place writes are durable: forget the batch. The side file is
+    // emptied without a sync; replaying it again would only rewrite the
+    // same bytes, and the next stage() replaces it first.
+    void finish() {
+        [[maybe_unused]] int truncated = ::ftruncate(fd, 0); // a failure is harmless for the same reason
+        writes.clear();
+        writeAt.clear();
+    }
+
+    // Write a complete side file left by a crash in place again, sync the
+    // targets and empty it. Returns the number of writes replayed, or -1
+    // if they could not be written.
+    long recover(const std::vector<int>& targets) {
+        struct stat info;
+        if(fd < 0 || ::fstat(fd, &info) != 0) return -1;
+        size_t size = static_cast<size_t>(info.st_size);
+        if(size < sizeof(FileHeader)) return 0;
+        std::string file(size, '\0');
+        if(::pread(fd, &file[0], size, 0) != static_cast<ssize_t>(size)) return -1;
+        FileHeader header;
+        std::memcpy(&header, file.data(), sizeof(header));
+        if(std::memcmp(header.magic, MAGIC, 4) != 0 || header.bodyBytes != size - sizeof(header)
+           || crc32(file.data() + sizeof(header), header.bodyBytes) != header.checksum) {
+            return 0; // torn while being staged: nothing was written in place
+        }
+        size_t position = sizeof(header);
+        std::vector<char> touched(targets.size(), 0);
+        for(uint32_t i = 0; i < header.count; i++) {
+            WriteHeader w;
+            if(size - position < sizeof(w)) return -1;
+            std::memcpy(&w, file.data() + position, sizeof(w));
+            position += sizeof(w);
+            if(w.target >= targets.size() || size - position < w.size) return -1;
+            if(::pwrite(targets[w.target], file.data() + position, w.size, static_cast<off_t>(w.offset))
+               != static_cast<ssize_t>(w.size)) {
+                return -1;
+            }
+            touched[w.target] = 1;
+            position += w.size;
+        }
+        for(size_t t = 0; t < targets.size(); t++) {
+            if(touched[t] && ::fdatasync(targets[t]) != 0) return -1;
+        }
+        if(::ftruncate(fd, 0) != 0 || ::fdatasync(fd) != 0) return -1;
+        return header.count;
+    }
+};
+
+// Replace one file atomically and durably
+inline bool writeFileDurably(const std::string& filename, std::string contents) {
+    GroupCommit commit;
+    commit.replace(filename, std::move(contents));
+    return commit.commit();
+}
+
+#endif
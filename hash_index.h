@@ -0,0 +1,61 @@
+// Open-addressing hash index over student index numbers, shared by the
+// attendance programs. The table is a vector of slots holding -1 (empty)
+// or the position of a student; an index number is looked up by linear
+// probing from its FNV-1a hash. The table size is a power of two, kept at
+// least twice the number of students. Index numbers compare exactly, or
+// ignoring ASCII case for callers that treat "ug1" and "UG1" as one.
+
+#ifndef HASH_INDEX_H
+#define HASH_INDEX_H
+
+#include <vector>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+// ASCII upper-casing, the same as toupper in the "C" locale the programs
+// run in, without a library call per character
+inline char foldIndexChar(char c) {
+    return (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c;
+}
+
+// FNV-1a over the characters, upper-cased if ignoreCase; no temporaries
+inline uint64_t hashIndexNumber(std::string_view key, bool ignoreCase) {
+    uint64_t h = 1469598103934665603ULL;
+    for(char c : key) {
+        h ^= static_cast<unsigned char>(ignoreCase ? foldIndexChar(c) : c);
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+inline bool sameIndexNumber(std::string_view a, std::string_view b, bool ignoreCase) {
+    if(!ignoreCase) return a == b;
+    if(a.size() != b.size()) return false;
+    for(size_t i = 0; i < a.size(); i++) {
+        if(foldIndexChar(a[i]) != foldIndexChar(b[i])) return false;
+    }
+    return true;
+}
+
+// Returns the slot holding key, or the empty slot where it belongs.
+// keyAt(position) gives the index number of the student at a position.
+template <typename KeyAt>
+size_t probeIndexSlot(const std::vector<int32_t>& slots, std::string_view key, bool ignoreCase, KeyAt keyAt) {
+    size_t mask = slots.size() - 1;
+    size_t pos = hashIndexNumber(key, ignoreCase) & mask;
+    while(slots[pos] != -1 && !sameIndexNumber(keyAt(slots[pos]), key, ignoreCase)) {
+        pos = (pos + 1) & mask;
+    }
+    return pos;
+}
+
+// Table size for count students, starting from the current size (at
+// least 16) so the table only ever grows
+inline size_t indexCapacityFor(size_t count, size_t current) {
+    size_t capacity = current < 16 ? 16 : current;
+    while(capacity < count * 2) capacity *= 2;
+    return capacity;
+}
+
+#endif
@@ -1,256 +1,143 @@
-#include <iostream>
-#include <string>
-#include <vector>
-#include <fstream>
-#include <algorithm>
-#include <cctype>
-#include <iomanip>
-#include <sstream>
-#include <map>
-#include <filesystem>
-
-using namespace std;
-namespace fs = std::filesystem;
-
-// Enum for attendance status
-enum AttendanceStatus { PRESENT, ABSENT, LATE };
-
-// Student Class
-class Student {
-private:
-    string indexNumber;
-    string name;
-    
-public:
-    Student() {}
-    
-    Student(string idx, string n) {
-        indexNumber = idx;
-        name = n;
-    }
-    
-    string getIndexNumber() const { return indexNumber; }
-    string getName() const { return name; }
-    
-    void setIndexNumber(string idx) { indexNumber = idx; }
-    void setName(string n) { name = n; }
-    
-    void display() const {
-        cout << "Index: " << indexNumber << " | Name: " << name << endl;
+// Console front end of the attendance system: the menus, prompts and
+// command-line tools. The data and its persistence live in
+// attendance_core.h, driven through its API.
+
+#include "attendance_core.h"
+#include <sys/wait.h>
+
+// Counts allocations in -DATTENDANCE_STATS builds
+ATTENDANCE_ALLOCATION_COUNTER()
+
+// Function prototypes
+void displayMainMenu();
+void registerStudent();
+void viewAllStudents();
+void searchStudentByIndex();
+void displaySessionMenu();
+void createLectureSession();
+void viewAllSessions();
+void selectAndMarkAttendance();
+void viewSessionReport();
+void viewReports();
+void markAttendanceForSession(size_t position);
+void viewAttendanceRates();
+void viewAttendanceHistory();
+void printHistoryFootprint();
+vector<size_t> filterSessions();
+int chooseSession(const vector<size_t>& matches, const string& action);
+void runSummaryBenchmark(int studentCount);
+void runParseBenchmark(int rows);
+void runStudentLoadBenchmark(int rows);
+void runDurableWriteBenchmark(int files, int fileBytes);
+void runBatchIoBenchmark(int sessionCount);
+int runCrashTest(int files);
+int runStoreCrashTest();
+int runBenchSuite(const vector<string>& args);
+AttendanceSession* findSessionBySpec(const string& spec);
+int importMarksCommand(const string& sessionSpec, const string& csvFile);
+void viewSystemStatistics();
+int liveCheckInCommand(const string& sessionSpec, int graceMinutes, const string& fifoPath);
+bool openForCommand();
+
+int main(int argc, char* argv[]) {
+    // Startup options
+    vector<string> args;
+    for(int i = 1; i < argc; i++) {
+        if(string(argv[i]) == "--load-threads" && i + 1 < argc) {
+            loadThreads = static_cast<unsigned>(stoi(argv[++i]));
+        } else {
+            args.push_back(argv[i]);
+        }
     }
     
-    // Convert to CSV format for saving
-    string toCSV() const {
-        return indexNumber + "," + name;
+    // Command-line tools run without the interactive menu
+    if(!args.empty() && args[0] == "bench-summary") {
+        runSummaryBenchmark(args.size() > 1 ? stoi(args[1]) : 10000);
+        return 0;
     }
-    
-    // Create from CSV string
-    static Student fromCSV(const string& csv) {
-        size_t commaPos = csv.find(',');
-        if(commaPos != string::npos) {
-            string idx = csv.substr(0, commaPos);
-            string name = csv.substr(commaPos + 1);
-            return Student(idx, name);
-        }
-        return Student();
+    if(!args.empty() && args[0] == "bench-parse") {
+        runParseBenchmark(args.size() > 1 ? stoi(args[1]) : 200000);
+        return 0;
     }
-};
-
-// AttendanceSession Class
-class AttendanceSession {
-private:
-    string courseCode;
-    string date;
-    string startTime;
-    string duration;
-    vector<string> studentIndices;
-    map<string, AttendanceStatus> attendanceRecords;
-    
-public:
-    AttendanceSession() {}
-    
-    AttendanceSession(string code, string d, string time, string dur) {
-        courseCode = code;
-        date = d;
-        startTime = time;
-        duration = dur;
+    if(!args.empty() && args[0] == "bench") {
+        return runBenchSuite(args);
     }
-    
-    // Getters
-    string getCourseCode() const { return courseCode; }
-    string getDate() const { return date; }
-    string getStartTime() const { return startTime; }
-    string getDuration() const { return duration; }
-    vector<string> getStudentIndices() const { return studentIndices; }
-    
-    // Setters
-    void setCourseCode(string code) { courseCode = code; }
-    void setDate(string d) { date = d; }
-    void setStartTime(string time) { startTime = time; }
-    void setDuration(string dur) { duration = dur; }
-    
-    void addAllStudents(const vector<Student>& allStudents) {
-        studentIndices.clear();
-        for(const auto& student : allStudents) {
-            studentIndices.push_back(student.getIndexNumber());
-        }
+    if(!args.empty() && args[0] == "bench-durable") {
+        runDurableWriteBenchmark(args.size() > 1 ? stoi(args[1]) : 200, args.size() > 2 ? stoi(args[2]) : 8192);
+        return 0;
     }
-    
-    void markAttendance(string index, AttendanceStatus status) {
-        attendanceRecords[index] = status;
+    if(!args.empty() && args[0] == "bench-io") {
+        runBatchIoBenchmark(args.size() > 1 ? stoi(args[1]) : 10000);
+        return 0;
     }
-    
-    AttendanceStatus getAttendanceStatus(string index) const {
-        auto it = attendanceRecords.find(index);
-        if(it != attendanceRecords.end()) {
-            return it->second;
-        }
-        return ABSENT;
+    if(!args.empty() && args[0] == "crash-test") {
+        return runCrashTest(args.size() > 1 ? stoi(args[1]) : 8);
     }
-    
-    bool isAttendanceMarked() const {
-        return !attendanceRecords.empty();
+    if(!args.empty() && args[0] == "bench-students") {
+        runStudentLoadBenchmark(args.size() > 1 ? stoi(args[1]) : 1000000);
+        return 0;
     }
-    
-    void getSummary(int &present, int &absent, int &late) const {
-        present = absent = late = 0;
-        for(const auto& record : attendanceRecords) {
-            switch(record.second) {
-                case PRESENT: present++; break;
-                case ABSENT: absent++; break;
-                case LATE: late++; break;
-            }
+    if(!args.empty() && args[0] == "import-marks") {
+        if(args.size() != 3) {
+            cout << "Usage: " << argv[0] << " import-marks COURSE/YYYY-MM-DD[/HH:MM] marks.csv\n";
+            return 2;
         }
+        if(!openForCommand()) return 1;
+        int status = importMarksCommand(args[1], args[2]);
+        return coreClose() == CORE_OK ? status : 1;
     }
-    
-    void display() const {
-        cout << "Course: " << courseCode << " | Date: " << date 
-             << " | Time: " << startTime << " | Duration: " << duration << "hrs\n";
-        if(isAttendanceMarked()) {
-            int p, a, l;
-            getSummary(p, a, l);
-            cout << "Attendance: P:" << p << " A:" << a << " L:" << l << "\n";
-        } else {
-            cout << "Attendance: Not marked yet\n";
+    if(!args.empty() && args[0] == "live") {
+        int graceMinutes = 10;
+        string fifoPath;
+        for(size_t i = 2; i + 1 < args.size(); i += 2) {
+            if(args[i] == "--grace") graceMinutes = stoi(args[i + 1]);
+            else if(args[i] == "--fifo") fifoPath = args[i + 1];
+        }
+        if(args.size() < 2 || args.size() % 2 != 0) {
+            cout << "Usage: " << argv[0] << " live COURSE/YYYY-MM-DD[/HH:MM] [--grace MINUTES] [--fifo PATH]\n";
+            return 2;
         }
+        if(!openForCommand()) return 1;
+        int status = liveCheckInCommand(args[1], graceMinutes, fifoPath);
+        return coreClose() == CORE_OK ? status : 1;
     }
     
-    string getFilename() const {
-        string filename = "session_";
-        filename += courseCode + "_";
-        filename += date + ".txt";
-        return filename;
+    // One process owns the data; with the daemon running, use its client
+    CoreResult locked = coreLockData();
+    if(locked != CORE_OK) {
+        cout << "✗ Error: " << coreResultMessage(locked) << "\n";
+        if(locked == CORE_LOCKED) cout << "Use attendance_client to work with the running daemon.\n";
+        return 1;
     }
     
-    // Save session to file
-    bool saveToFile() const {
-        string filename = getFilename();
-        ofstream file(filename);
-        
-        if(!file.is_open()) {
-            return false;
-        }
-        
-        // Save session header
-        file << "COURSE:" << courseCode << endl;
-        file << "DATE:" << date << endl;
-        file << "TIME:" << startTime << endl;
-        file << "DURATION:" << duration << endl;
-        file << "STUDENTS:" << studentIndices.size() << endl;
-        
-        // Save student indices
-        for(const auto& index : studentIndices) {
-            file << "INDEX:" << index << endl;
-        }
-        
-        // Save attendance records if any
-        file << "ATTENDANCE:" << attendanceRecords.size() << endl;
-        for(const auto& record : attendanceRecords) {
-            file << record.first << ":" << static_cast<int>(record.second) << endl;
+#ifdef ATTENDANCE_STATS
+    // SIGUSR1 dumps the statistics. The signal is blocked here, before any
+    // other thread starts, so only the waiting thread ever receives it.
+    sigset_t statsSignals;
+    sigemptyset(&statsSignals);
+    sigaddset(&statsSignals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &statsSignals, nullptr);
+    atomic<bool> statsStopping(false);
+    thread statsSignalThread([&]() {
+        int signal;
+        while(sigwait(&statsSignals, &signal) == 0 && !statsStopping) {
+            writeStatsFile(STATS_FILE);
         }
-        
-        file.close();
-        return true;
-    }
+    });
+#endif
     
-    // Load session from file
-    bool loadFromFile(const string& filename, const vector<Student>& allStudents) {
-        ifstream file(filename);
-        if(!file.is_open()) {
-            return false;
-        }
-        
-        string line;
-        string header;
-        int studentCount = 0;
-        int attendanceCount = 0;
-        
-        while(getline(file, line)) {
-            size_t colonPos = line.find(':');
-            if(colonPos == string::npos) continue;
-            
-            header = line.substr(0, colonPos);
-            string value = line.substr(colonPos + 1);
-            
-            if(header == "COURSE") {
-                courseCode = value;
-            } else if(header == "DATE") {
-                date = value;
-            } else if(header == "TIME") {
-                startTime = value;
-            } else if(header == "DURATION") {
-                duration = value;
-            } else if(header == "STUDENTS") {
-                studentCount = stoi(value);
-            } else if(header == "INDEX") {
-                studentIndices.push_back(value);
-            } else if(header == "ATTENDANCE") {
-                attendanceCount = stoi(value);
-            } else if(attendanceCount > 0) {
-                // This is an attendance record
-                int statusInt = stoi(value);
-                attendanceRecords[header] = static_cast<AttendanceStatus>(statusInt);
-                attendanceCount--;
-            }
-        }
-        
-        file.close();
-        return true;
-    }
-};
-
-// Global vectors
-vector<Student> students;
-vector<AttendanceSession> sessions;
-
-// File paths
-const string STUDENT_FILE = "students.txt";
-
-// Function prototypes
-void displayMainMenu();
-void registerStudent();
-void viewAllStudents();
-void searchStudentByIndex();
-void displaySessionMenu();
-void createLectureSession();
-void viewAllSessions();
-void selectAndMarkAttendance();
-void viewSessionReport();
-void markAttendanceForSession(AttendanceSession &session);
-void saveAllData();
-void loadAllData();
-string toUpperCase(string str);
-bool isValidIndexNumber(string index);
-bool isValidDate(string date);
-bool isValidTime(string time);
-bool isValidDuration(string dur);
-string statusToString(AttendanceStatus status);
-char statusToChar(AttendanceStatus status);
-AttendanceStatus charToStatus(char c);
-
-int main() {
     // Load existing data at startup
-    loadAllData();
+    CoreResult opened = coreOpen();
+    if(opened != CORE_OK) {
+        cout << "✗ Error: " << coreResultMessage(opened) << endl;
+        compactor.stop();
+#ifdef ATTENDANCE_STATS
+        statsStopping = true;
+        pthread_kill(statsSignalThread.native_handle(), SIGUSR1);
+        statsSignalThread.join();
+#endif
+        return 1;
+    }
     
     cout << "========================================\n";
     cout << "   DIGITAL ATTENDANCE SYSTEM - FINAL    \n";
@@ -258,6 +145,10 @@ int main() {
     
     int choice;
     do {
+        // Saves run in the background; report one that failed
+        if(backgroundWriter.hasLeftovers()) {
+            cout << "\n✗ Warning: Some changes could not be written to disk yet; they will be retried.\n";
+        }
         displayMainMenu();
         cout << "Enter your choice: ";
         cin >> choice;
@@ -266,7 +157,7 @@ int main() {
         switch(choice) {
             case 1:
                 registerStudent();
-                saveAllData(); // Save after each modification
+                coreSave(); // Queue a save after each modification
                 break;
             case 2:
                 viewAllStudents();
@@ -278,14 +169,31 @@ int main() {
                 displaySessionMenu();
                 break;
             case 5:
+                viewAttendanceRates();
+                break;
+            case 6:
+                viewSystemStatistics();
+                break;
+            case 7:
+                viewAttendanceHistory();
+                break;
+            case 8:
                 cout << "\nExiting program. Goodbye!\n";
-                saveAllData(); // Final save before exit
+                coreClose(); // Wait for queued saves, final save before exit
+#ifdef ATTENDANCE_STATS
+                statsStopping = true;
+                pthread_kill(statsSignalThread.native_handle(), SIGUSR1);
+                statsSignalThread.join();
+                if(writeStatsFile(STATS_FILE)) {
+                    cout << "✓ Statistics written to " << STATS_FILE << endl;
+                }
+#endif
                 break;
             default:
-                cout << "\nInvalid choice! Please enter a number between 1-5.\n";
+                cout << "\nInvalid choice! Please enter a number between 1-8.\n";
         }
         cout << endl;
-    } while(choice != 5);
+    } while(choice != 8);
     
     return 0;
 }
@@ -296,81 +204,201 @@ void displayMainMenu() {
     cout << "2. View All Students\n";
     cout << "3. Search Student by Index\n";
     cout << "4. Attendance Session Management\n";
-    cout << "5. Exit\n";
+    cout << "5. Student Attendance Rates\n";
+    cout << "6. System Statistics\n";
+    cout << "7. Attendance History Queries\n";
+    cout << "8. Exit\n";
     cout << "---------------------------\n";
 }
 
-// File handling functions
-void saveAllData() {
-    // Save students
-    ofstream studentFile(STUDENT_FILE);
-    if(studentFile.is_open()) {
-        for(const auto& student : students) {
-            studentFile << student.toCSV() << endl;
+void viewAttendanceRates() {
+    cout << "\n--- STUDENT ATTENDANCE RATES ---\n";
+    
+    if(students.empty()) {
+        cout << "No students registered yet.\n";
+        return;
+    }
+    
+    auto start = chrono::steady_clock::now();
+    bool firstBuild = !students.countsActive();
+    buildAttendanceCounts();
+    if(firstBuild) {
+        cout << "(Totals built from " << sessions.size() << " sessions in " << fixed << setprecision(1)
+             << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms)\n";
+    }
+    
+    string searchIndex;
+    cout << "Enter Index Number (blank for all students): ";
+    getline(cin, searchIndex);
+    searchIndex = toUpperCase(searchIndex);
+    
+    int32_t onlyId = StudentRegistry::NO_ID;
+    if(!searchIndex.empty()) {
+        onlyId = students.findId(searchIndex);
+        if(onlyId == StudentRegistry::NO_ID || !students.isRegistered(static_cast<uint32_t>(onlyId))) {
+            cout << "\n✗ No student found with index number: " << searchIndex << endl;
+            return;
         }
-        studentFile.close();
-        cout << "\n✓ Students saved to file.\n";
-    } else {
-        cout << "\n✗ Error: Could not save students to file.\n";
     }
     
-    // Save sessions
-    for(const auto& session : sessions) {
-        if(session.saveToFile()) {
-            cout << "✓ Session saved: " << session.getFilename() << endl;
+    cout << "\n" << left << setw(15) << "Index" << setw(25) << "Name" << right
+         << setw(9) << "Sessions" << setw(8) << "Present" << setw(6) << "Late" << setw(8) << "Absent"
+         << setw(9) << "Rate" << "\n";
+    cout << string(80, '-') << "\n";
+    
+    lock_guard<mutex> lock(dataMutex);
+    for(uint32_t id = 0; id < students.idCount(); id++) {
+        if(!students.isRegistered(id)) continue;
+        if(onlyId != StudentRegistry::NO_ID && id != static_cast<uint32_t>(onlyId)) continue;
+        
+        const AttendanceCounts& c = students.getCounts(id);
+        uint32_t marked = c.present + c.late + c.absent;
+        cout << left << setw(15) << students[id].getIndexNumber() << setw(25) << students[id].getName() << right
+             << setw(9) << c.enrolled << setw(8) << c.present << setw(6) << c.late << setw(8) << c.absent;
+        if(marked > 0) {
+            cout << setw(8) << fixed << setprecision(1) << (c.present + c.late) * 100.0 / marked << "%\n";
+        } else {
+            cout << setw(9) << "-" << "\n";
         }
     }
+    cout << left;
+    cout << "\nRate = (present + late) / sessions marked for the student.\n";
 }
 
-void loadAllData() {
-    // Load students
-    ifstream studentFile(STUDENT_FILE);
-    if(studentFile.is_open()) {
-        string line;
-        while(getline(studentFile, line)) {
-            if(!line.empty()) {
-                Student s = Student::fromCSV(line);
-                students.push_back(s);
-            }
-        }
-        studentFile.close();
-        cout << "✓ Loaded " << students.size() << " students from file.\n";
+// Longitudinal queries over each student's marks in every session,
+// answered from the compressed history index
+void viewAttendanceHistory() {
+    cout << "\n--- ATTENDANCE HISTORY QUERIES ---\n";
+    
+    if(sessions.empty()) {
+        cout << "No sessions available.\n";
+        return;
     }
     
-    // Load sessions - look for session_*.txt files
-    int sessionCount = 0;
-    for(const auto& entry : fs::directory_iterator(".")) {
-        string filename = entry.path().filename().string();
-        if(filename.find("session_") == 0 && filename.length() > 8) {
-            AttendanceSession session;
-            if(session.loadFromFile(filename, students)) {
-                sessions.push_back(session);
-                sessionCount++;
-            }
-        }
+    cout << "1. Students absent from more than N sessions in a row\n";
+    cout << "2. Students PRESENT, ABSENT or LATE in more than N% of their sessions\n";
+    int choice;
+    cout << "Select query (0 to cancel): ";
+    cin >> choice;
+    cin.ignore();
+    if(choice < 1 || choice > 2) {
+        cout << "Operation cancelled.\n";
+        return;
     }
     
-    if(sessionCount > 0) {
-        cout << "✓ Loaded " << sessionCount << " sessions from files.\n";
+    string course;
+    cout << "Course code (blank for all sessions): ";
+    getline(cin, course);
+    
+    AttendanceStatus status = ABSENT;
+    if(choice == 2) {
+        string statusText;
+        do {
+            cout << "Status (P/A/L): ";
+            getline(cin, statusText);
+        } while(statusText.size() != 1 || string("PALpal").find(statusText[0]) == string::npos);
+        status = charToStatus(statusText[0]);
     }
-    cout << endl;
+    
+    double threshold;
+    cout << (choice == 1 ? "More than how many sessions in a row? " : "More than what percentage? ");
+    cin >> threshold;
+    cin.ignore();
+    if(!cin || threshold < 0) {
+        cin.clear();
+        cout << "Operation cancelled.\n";
+        return;
+    }
+    
+    auto start = chrono::steady_clock::now();
+    bool firstBuild = !students.history().active();
+    vector<HistoryMatch> matches;
+    CoreResult result = choice == 1 ? coreAbsenceStreaks(course, static_cast<uint32_t>(threshold), matches)
+                                    : coreStatusShares(course, status, threshold, matches);
+    double millis = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    if(result == CORE_NOT_FOUND) {
+        cout << "\n✗ No sessions found for course: " << toUpperCase(course) << endl;
+        return;
+    }
+    
+    cout << "\n" << left << setw(15) << "Index" << setw(25) << "Name" << right;
+    if(choice == 1) cout << setw(12) << "Streak" << "\n";
+    else cout << setw(8) << "Count" << setw(8) << "Marked" << setw(9) << "Share" << "\n";
+    cout << string(choice == 1 ? 52 : 65, '-') << "\n";
+    for(const auto& match : matches) {
+        cout << left << setw(15) << match.indexNumber << setw(25) << match.name << right;
+        if(choice == 1) {
+            cout << setw(12) << match.count << "\n";
+        } else {
+            cout << setw(8) << match.count << setw(8) << match.marked << setw(8) << fixed << setprecision(1)
+                 << match.count * 100.0 / match.marked << "%\n";
+        }
+    }
+    cout << left;
+    cout << "\n" << matches.size() << " student(s) matched in " << fixed << setprecision(1) << millis << " ms"
+         << (firstBuild ? " (including building the history index)" : "") << ".\n";
+    cout.unsetf(ios::fixed);
+    cout << setprecision(6);
+    
+    printHistoryFootprint();
 }
 
-string toUpperCase(string str) {
-    for(char &c : str) {
-        c = toupper(c);
+void printHistoryFootprint() {
+    HistoryFootprint f = coreHistoryFootprint();
+    cout << "History index: " << f.runs << " runs for " << f.students << " student(s) over " << f.columns
+         << " session(s), " << f.bytes << " bytes (plain bitmaps: " << f.plainBytes << " bytes).\n";
+}
+
+// Counters and timers since startup; see ATTENDANCE_STATS
+void viewSystemStatistics() {
+    cout << "\n--- SYSTEM STATISTICS ---\n";
+    size_t writerRounds, writerCoalesced;
+    backgroundWriter.getCounts(writerRounds, writerCoalesced);
+    cout << "Background writer: " << writerRounds << " write round(s), "
+         << writerCoalesced << " queued session save(s) coalesced.\n";
+    {
+        lock_guard<mutex> lock(dataMutex);
+        cout << "Roster snapshots: " << students.rosterCount() << " version(s) shared by "
+             << sessions.size() << " session(s).\n";
+    }
+    if(students.history().active()) {
+        printHistoryFootprint();
+    } else {
+        cout << "History index: not built yet (built by the first history query).\n";
     }
-    return str;
+#ifndef ATTENDANCE_STATS
+    cout << "Statistics are not compiled in. Rebuild with -DATTENDANCE_STATS to collect them.\n";
+#else
+    StatTotals totals = statsSnapshot();
+    cout << left << setw(16) << "Counter" << right << setw(16) << "Value" << "\n";
+    cout << string(32, '-') << "\n";
+    for(int i = 0; i < STAT_COUNTER_COUNT; i++) {
+        cout << left << setw(16) << STAT_COUNTER_NAMES[i] << right << setw(16) << totals.counters[i] << "\n";
+    }
+    
+    cout << "\n" << left << setw(16) << "Timer" << right << setw(10) << "Calls" << setw(14) << "Total ms"
+         << setw(12) << "Avg us" << setw(12) << "Max us" << "\n";
+    cout << string(64, '-') << "\n";
+    cout << fixed << setprecision(1);
+    for(int i = 0; i < TIMER_COUNT; i++) {
+        uint64_t calls = totals.timerCalls[i];
+        cout << left << setw(16) << STAT_TIMER_NAMES[i] << right << setw(10) << calls
+             << setw(14) << totals.timerNanos[i] / 1e6
+             << setw(12) << (calls > 0 ? totals.timerNanos[i] / 1e3 / calls : 0.0)
+             << setw(12) << totals.timerMaxNanos[i] / 1e3 << "\n";
+    }
+    cout.unsetf(ios::fixed);
+    cout << setprecision(6) << left;
+    cout << "\nSend SIGUSR1 (kill -USR1 " << getpid() << ") to write " << STATS_FILE << ".\n";
+#endif
 }
 
 bool isValidIndexNumber(string index) {
     if(index.empty()) return false;
     
-    for(const auto& student : students) {
-        if(toUpperCase(student.getIndexNumber()) == toUpperCase(index)) {
-            cout << "\nError: Index number already exists!\n";
-            return false;
-        }
+    if(students.contains(index)) {
+        cout << "\nError: Index number already exists!\n";
+        return false;
     }
     return true;
 }
@@ -392,8 +420,11 @@ void registerStudent() {
     cout << "Enter Student Name: ";
     getline(cin, name);
     
-    Student newStudent(indexNumber, name);
-    students.push_back(newStudent);
+    CoreResult result = coreRegisterStudent(indexNumber, name);
+    if(result != CORE_OK) {
+        cout << "\nError: Could not register " << indexNumber << ": " << coreResultMessage(result) << "\n";
+        return;
+    }
     
     cout << "\n✓ Student registered successfully!\n";
     cout << "Total students: " << students.size() << endl;
@@ -408,14 +439,18 @@ void viewAllStudents() {
     }
     
     cout << "Total students: " << students.size() << "\n\n";
-    cout << left << setw(5) << "No." << setw(15) << "Index" << "Name\n";
-    cout << "----------------------------------------\n";
     
-    for(size_t i = 0; i < students.size(); i++) {
-        cout << left << setw(5) << (i + 1) 
-             << setw(15) << students[i].getIndexNumber() 
-             << students[i].getName() << endl;
+    STAT_SCOPE(TIMER_REPORT);
+    ReportWriter report;
+    report.beginTable({{"No.", 5, false}, {"Index", 15, false}, {"Name", 0, false}});
+    size_t row = 0;
+    string number;
+    for(uint32_t id = 0; id < students.idCount(); id++) {
+        if(!students.isRegistered(id)) continue;
+        number = to_string(++row);
+        report.row({number, students[id].getIndexNumber(), students[id].getName()});
     }
+    report.endTable();
 }
 
 void searchStudentByIndex() {
@@ -432,18 +467,12 @@ void searchStudentByIndex() {
     
     searchIndex = toUpperCase(searchIndex);
     
-    bool found = false;
-    for(const auto& student : students) {
-        if(student.getIndexNumber() == searchIndex) {
-            cout << "\n✓ Student Found!\n";
-            cout << "Index: " << student.getIndexNumber() << endl;
-            cout << "Name: " << student.getName() << endl;
-            found = true;
-            break;
-        }
-    }
-    
-    if(!found) {
+    const Student* student = students.find(searchIndex);
+    if(student != nullptr) {
+        cout << "\n✓ Student Found!\n";
+        cout << "Index: " << student->getIndexNumber() << endl;
+        cout << "Name: " << student->getName() << endl;
+    } else {
         cout << "\n✗ No student found with index number: " << searchIndex << endl;
     }
 }
@@ -457,7 +486,8 @@ void displaySessionMenu() {
         cout << "2. View All Sessions\n";
         cout << "3. Mark Attendance for a Session\n";
         cout << "4. View Session Report\n";
-        cout << "5. Back to Main Menu\n";
+        cout << "5. Reports and Export\n";
+        cout << "6. Back to Main Menu\n";
         cout << "-------------------------------\n";
         cout << "Enter your choice: ";
         cin >> choice;
@@ -477,57 +507,15 @@ void displaySessionMenu() {
                 viewSessionReport();
                 break;
             case 5:
+                viewReports();
+                break;
+            case 6:
                 cout << "\nReturning to main menu...\n";
                 break;
             default:
                 cout << "\nInvalid choice!\n";
         }
-    } while(choice != 5);
-}
-
-bool isValidDate(string date) {
-    if(date.length() != 10) return false;
-    if(date[4] != '-' || date[7] != '-') return false;
-    
-    for(int i = 0; i < 10; i++) {
-        if(i == 4 || i == 7) continue;
-        if(!isdigit(date[i])) return false;
-    }
-    
-    // Basic range validation
-    int year = stoi(date.substr(0, 4));
-    int month = stoi(date.substr(5, 2));
-    int day = stoi(date.substr(8, 2));
-    
-    if(year < 2024 || year > 2026) return false;
-    if(month < 1 || month > 12) return false;
-    if(day < 1 || day > 31) return false;
-    
-    return true;
-}
-
-bool isValidTime(string time) {
-    if(time.length() != 5) return false;
-    if(time[2] != ':') return false;
-    
-    for(int i = 0; i < 5; i++) {
-        if(i == 2) continue;
-        if(!isdigit(time[i])) return false;
-    }
-    
-    int hours = stoi(time.substr(0, 2));
-    int minutes = stoi(time.substr(3, 2));
-    
-    return (hours >= 0 && hours <= 23 && minutes >= 0 && minutes <= 59);
-}
-
-bool isValidDuration(string dur) {
-    if(dur.empty()) return false;
-    for(char c : dur) {
-        if(!isdigit(c)) return false;
-    }
-    int duration = stoi(dur);
-    return (duration > 0 && duration <= 4);
+    } while(choice != 6);
 }
 
 void createLectureSession() {
@@ -540,9 +528,14 @@ void createLectureSession() {
     
     string courseCode, date, startTime, duration;
     
-    cout << "Enter Course Code (e.g., EEE227): ";
-    getline(cin, courseCode);
-    courseCode = toUpperCase(courseCode);
+    do {
+        cout << "Enter Course Code (e.g., EEE227): ";
+        getline(cin, courseCode);
+        courseCode = toUpperCase(courseCode);
+        if(courseCode.length() > MAX_COURSE_CODE_LENGTH) {
+            cout << "Course code too long! Please use at most " << MAX_COURSE_CODE_LENGTH << " characters\n";
+        }
+    } while(courseCode.length() > MAX_COURSE_CODE_LENGTH);
     
     do {
         cout << "Enter Date (YYYY-MM-DD): ";
@@ -568,17 +561,22 @@ void createLectureSession() {
         }
     } while(!isValidDuration(duration));
     
-    AttendanceSession newSession(courseCode, date, startTime, duration);
-    newSession.addAllStudents(students);
-    sessions.push_back(newSession);
-    
-    // Save immediately
-    newSession.saveToFile();
+    // Created at once and written by the background writer
+    size_t position;
+    CoreResult result = coreCreateSession(courseCode, date, startTime, duration, &position);
+    if(result == CORE_DUPLICATE) {
+        cout << "\nError: A session of " << courseCode << " already exists on " << date << " at " << startTime << "!\n";
+        return;
+    }
+    if(result != CORE_OK) {
+        cout << "\nError: Could not create the session: " << coreResultMessage(result) << "\n";
+        return;
+    }
     
     cout << "\n✓ Lecture session created successfully!\n";
     cout << "Session Details:\n";
     cout << "--------------------------------\n";
-    newSession.display();
+    sessions[position].display();
     cout << "--------------------------------\n";
     cout << "Total students in session: " << students.size() << endl;
 }
@@ -591,42 +589,71 @@ void viewAllSessions() {
         return;
     }
     
-    cout << "Total sessions: " << sessions.size() << "\n\n";
+    vector<size_t> matches = filterSessions();
+    cout << "Total sessions: " << sessions.size() << ", matching: " << matches.size() << "\n\n";
     
-    for(size_t i = 0; i < sessions.size(); i++) {
+    for(size_t i = 0; i < matches.size(); i++) {
+        const AttendanceSession& session = sessions[matches[i]];
         cout << "Session #" << i + 1 << ":\n";
-        sessions[i].display();
-        cout << "File: " << sessions[i].getFilename() << "\n";
+        session.display();
+        cout << "Record: " << session.getRecordName() << "\n";
         cout << "--------------------------------\n";
     }
 }
 
-string statusToString(AttendanceStatus status) {
-    switch(status) {
-        case PRESENT: return "PRESENT";
-        case ABSENT: return "ABSENT";
-        case LATE: return "LATE";
-        default: return "UNKNOWN";
+// Prompts for a filter and returns the matching positions in sessions, in
+// (course, date, time) order. The filter is a course code, or a prefix
+// ending in '*', optionally followed by a FROM date and a TO date
+// (YYYY-MM-DD); a single date selects that day. Blank selects everything.
+vector<size_t> filterSessions() {
+    string line;
+    cout << "Filter (COURSE or PREFIX*, optional FROM [TO] date; blank = all): ";
+    getline(cin, line);
+    
+    istringstream in(line);
+    string course, fromDate, toDate;
+    in >> course >> fromDate >> toDate;
+    if(course.empty()) return sessionIndex.all();
+    
+    course = toUpperCase(course);
+    bool prefix = course.back() == '*';
+    if(prefix) course.pop_back();
+    if(!fromDate.empty() && toDate.empty()) toDate = fromDate;
+    for(const string& date : {fromDate, toDate}) {
+        if(!date.empty() && !isValidDate(date)) {
+            cout << "Invalid date " << date << "; showing the course without a date range.\n";
+            fromDate.clear();
+            toDate.clear();
+            break;
+        }
     }
+    return sessionIndex.query(course, prefix, fromDate, toDate);
 }
 
-char statusToChar(AttendanceStatus status) {
-    switch(status) {
-        case PRESENT: return 'P';
-        case ABSENT: return 'A';
-        case LATE: return 'L';
-        default: return '?';
+// Lists the matching sessions and asks for one; returns its position in
+// sessions, or -1 when cancelled or nothing matches.
+int chooseSession(const vector<size_t>& matches, const string& action) {
+    if(matches.empty()) {
+        cout << "No sessions match the filter.\n";
+        return -1;
     }
-}
-
-AttendanceStatus charToStatus(char c) {
-    c = toupper(c);
-    switch(c) {
-        case 'P': return PRESENT;
-        case 'A': return ABSENT;
-        case 'L': return LATE;
-        default: return ABSENT;
+    
+    cout << "\nMatching Sessions:\n";
+    for(size_t i = 0; i < matches.size(); i++) {
+        cout << i + 1 << ". ";
+        sessions[matches[i]].display();
+    }
+    
+    int sessionChoice;
+    cout << "\nSelect session number to " << action << " (0 to cancel): ";
+    cin >> sessionChoice;
+    cin.ignore();
+    
+    if(sessionChoice <= 0 || sessionChoice > static_cast<int>(matches.size())) {
+        cout << "Operation cancelled.\n";
+        return -1;
     }
+    return static_cast<int>(matches[sessionChoice - 1]);
 }
 
 void selectAndMarkAttendance() {
@@ -637,42 +664,32 @@ void selectAndMarkAttendance() {
         return;
     }
     
-    cout << "\nAvailable Sessions:\n";
-    for(size_t i = 0; i < sessions.size(); i++) {
-        cout << i + 1 << ". ";
-        sessions[i].display();
-    }
+    int position = chooseSession(filterSessions(), "mark attendance");
+    if(position < 0) return;
     
-    int sessionChoice;
-    cout << "\nSelect session number to mark attendance (0 to cancel): ";
-    cin >> sessionChoice;
-    cin.ignore();
-    
-    if(sessionChoice == 0 || sessionChoice > static_cast<int>(sessions.size())) {
-        cout << "Operation cancelled.\n";
+    markAttendanceForSession(position);
+}
+
+void markAttendanceForSession(size_t position) {
+    AttendanceSession &session = sessions[position];
+    if(!touchSession(session)) {
+        cout << "\n✗ Error: Could not read session " << session.getRecordName() << " from " << SESSION_DATA_FILE << endl;
         return;
     }
     
-    markAttendanceForSession(sessions[sessionChoice - 1]);
-}
-
-void markAttendanceForSession(AttendanceSession &session) {
     cout << "\n--- MARKING ATTENDANCE ---\n";
     cout << "Session: ";
     session.display();
     cout << "\nInstructions: Enter P for Present, A for Absent, L for Late\n";
     cout << "------------------------------------------------\n";
     
-    vector<string> studentIndices = session.getStudentIndices();
+    const vector<uint32_t>& rosterIds = session.getRosterIds();
+    vector<pair<string, AttendanceStatus>> marks;
+    marks.reserve(rosterIds.size());
     
-    for(const auto& index : studentIndices) {
-        string studentName;
-        for(const auto& student : students) {
-            if(student.getIndexNumber() == index) {
-                studentName = student.getName();
-                break;
-            }
-        }
+    for(uint32_t id : rosterIds) {
+        const string& index = students[id].getIndexNumber();
+        const string& studentName = students[id].getName();
         
         char statusChar;
         bool validInput = false;
@@ -683,24 +700,33 @@ void markAttendanceForSession(AttendanceSession &session) {
             cin.ignore();
             
             statusChar = toupper(statusChar);
-            if(statusChar == 'P' || statusChar == 'A' || statusChar == 'L') {
+            if(isValidStatusChar(statusChar)) {
                 validInput = true;
             } else {
                 cout << "Invalid input! Please enter P, A, or L.\n";
             }
         } while(!validInput);
         
-        AttendanceStatus status = charToStatus(statusChar);
-        session.markAttendance(index, status);
+        marks.push_back({index, charToStatus(statusChar)});
     }
     
-    // Save after marking
-    session.saveToFile();
-    
-    cout << "\n✓ Attendance marked and saved successfully!\n";
+    // The marks are applied at once; the background writer commits the
+    // whole batch to the journal with one fsync and the compactor folds it
+    // into the session store later. Wait for the journal before saying
+    // the marks are saved.
+    CoreResult result = coreMarkAttendance(position, marks);
+    if(result != CORE_OK) {
+        cout << "\n✗ Error: Could not save the attendance: " << coreResultMessage(result) << endl;
+        return;
+    }
+    if(coreFlush() != CORE_OK) {
+        cout << "\n✗ Warning: Attendance marked, but it could not be written to disk yet; it will be retried.\n";
+    } else {
+        cout << "\n✓ Attendance marked and saved successfully!\n";
+    }
     
     int p, a, l;
-    session.getSummary(p, a, l);
+    coreSessionSummary(position, p, a, l);
     cout << "\nSummary for this session:\n";
     cout << "Present: " << p << " | Absent: " << a << " | Late: " << l << endl;
     cout << "Total: " << (p + a + l) << " students\n";
@@ -714,69 +740,1413 @@ void viewSessionReport() {
         return;
     }
     
-    cout << "\nAvailable Sessions:\n";
-    for(size_t i = 0; i < sessions.size(); i++) {
-        cout << i + 1 << ". ";
-        sessions[i].display();
+    int position = chooseSession(filterSessions(), "view report");
+    if(position < 0) return;
+    
+    AttendanceSession &session = sessions[position];
+    if(!touchSession(session)) {
+        cout << "\n✗ Error: Could not read session " << session.getRecordName() << " from " << SESSION_DATA_FILE << endl;
+        return;
     }
     
-    int sessionChoice;
-    cout << "\nSelect session number to view report (0 to cancel): ";
-    cin >> sessionChoice;
-    cin.ignore();
+    ReportWriter report;
+    renderSessionReport(session, report);
+}
+
+// Reports menu: pick a session, course or semester report and show it
+// or save it as text, CSV or HTML
+void viewReports() {
+    cout << "\n--- REPORTS ---\n";
+    
+    if(sessions.empty()) {
+        cout << "No sessions available.\n";
+        return;
+    }
     
-    if(sessionChoice == 0 || sessionChoice > static_cast<int>(sessions.size())) {
+    cout << "1. Single session report\n";
+    cout << "2. Course report (course or PREFIX*, optional date range)\n";
+    cout << "3. Semester report (all courses in a date range)\n";
+    int choice;
+    cout << "Select report (0 to cancel): ";
+    cin >> choice;
+    cin.ignore();
+    if(choice < 1 || choice > 3) {
         cout << "Operation cancelled.\n";
         return;
     }
     
-    AttendanceSession &session = sessions[sessionChoice - 1];
+    vector<size_t> matches;
+    int sessionPosition = -1;
+    string fromDate, toDate;
+    if(choice == 1) {
+        sessionPosition = chooseSession(filterSessions(), "report on");
+        if(sessionPosition < 0) return;
+        if(!touchSession(sessions[sessionPosition])) {
+            cout << "\n✗ Error: Could not read session " << sessions[sessionPosition].getRecordName()
+                 << " from " << SESSION_DATA_FILE << endl;
+            return;
+        }
+    } else if(choice == 2) {
+        matches = filterSessions();
+    } else {
+        do {
+            cout << "From date (YYYY-MM-DD): ";
+            getline(cin, fromDate);
+        } while(!isValidDate(fromDate));
+        do {
+            cout << "To date (YYYY-MM-DD): ";
+            getline(cin, toDate);
+        } while(!isValidDate(toDate));
+        matches = sessionIndex.query("", true, fromDate, toDate);
+    }
+    if(choice != 1 && matches.empty()) {
+        cout << "No sessions match.\n";
+        return;
+    }
     
-    cout << "\n========== ATTENDANCE REPORT ==========\n";
-    cout << "Course: " << session.getCourseCode() << "\n";
-    cout << "Date: " << session.getDate() << "\n";
-    cout << "Time: " << session.getStartTime() << "\n";
-    cout << "Duration: " << session.getDuration() << " hours\n";
-    cout << "File: " << session.getFilename() << "\n";
-    cout << "========================================\n\n";
+    string filename;
+    cout << "Save to file (.txt, .csv or .html; blank to show here): ";
+    getline(cin, filename);
     
-    if(!session.isAttendanceMarked()) {
-        cout << "Attendance has not been marked for this session yet.\n";
+    unique_ptr<ReportWriter> report(filename.empty() ? new ReportWriter() : new ReportWriter(filename));
+    if(!report->isOpen()) {
+        cout << "✗ Error: Could not create " << filename << endl;
         return;
     }
     
-    cout << "ATTENDANCE LIST:\n";
-    cout << "------------------------------------------------\n";
-    cout << left << setw(15) << "Index" << setw(30) << "Name" << "Status\n";
-    cout << "------------------------------------------------\n";
+    bool ok = true;
+    if(choice == 1) {
+        renderSessionReport(sessions[sessionPosition], *report);
+    } else if(choice == 2) {
+        string label = matches.size() > 0 ? sessions[matches.front()].getCourseCode() : "";
+        if(!sessions[matches.back()].getCourseCode().empty() && sessions[matches.back()].getCourseCode() != label) {
+            label += " .. " + sessions[matches.back()].getCourseCode();
+        }
+        ok = renderCourseReport(matches, label, *report);
+    } else {
+        ok = renderSemesterReport(matches, fromDate, toDate, *report);
+    }
+    if(!ok) {
+        report->finish();
+        cout << "\n✗ Error: Could not read a session from " << SESSION_DATA_FILE << "; the report is incomplete.\n";
+        return;
+    }
     
-    vector<string> indices = session.getStudentIndices();
-    for(const auto& index : indices) {
-        string studentName;
-        for(const auto& student : students) {
-            if(student.getIndexNumber() == index) {
-                studentName = student.getName();
-                break;
+    if(!report->finish()) {
+        cout << "\n✗ Error: Could not write " << filename << endl;
+    } else if(!filename.empty()) {
+        cout << "\n✓ Report written to " << filename << " (" << report->getBytesWritten() << " bytes).\n";
+    }
+}
+
+// Micro-benchmark: summary of one session of studentCount students,
+// map walk (previous representation) vs bitplane popcount
+void runSummaryBenchmark(int studentCount) {
+    const int iterations = 2000;
+    StudentRegistry registry;
+    registry.reserve(studentCount);
+    for(int i = 0; i < studentCount; i++) {
+        registry.insert(Student("STU" + to_string(i), "Student " + to_string(i)));
+    }
+    
+    AttendanceSession session("BENCH101", "2025-01-01", "08:00", "2");
+    session.addAllStudents(registry);
+    map<string, AttendanceStatus> records;
+    mt19937 rng(42);
+    for(uint32_t id : session.getRosterIds()) {
+        AttendanceStatus status = static_cast<AttendanceStatus>(rng() % 3);
+        session.markAttendance(id, status);
+        records[registry[id].getIndexNumber()] = status;
+    }
+    
+    int p = 0, a = 0, l = 0;
+    long long checksum = 0;
+    
+    auto start = chrono::steady_clock::now();
+    for(int it = 0; it < iterations; it++) {
+        p = a = l = 0;
+        for(const auto& record : records) {
+            switch(record.second) {
+                case PRESENT: p++; break;
+                case ABSENT: a++; break;
+                case LATE: l++; break;
+            }
+        }
+        checksum += p + a + l;
+    }
+    double mapNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / iterations;
+    
+    start = chrono::steady_clock::now();
+    for(int it = 0; it < iterations; it++) {
+        session.getSummary(p, a, l);
+        checksum += p + a + l;
+    }
+    double bitsNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / iterations;
+    
+    cout << "Session of " << studentCount << " students, " << iterations << " summaries each\n";
+    cout << "Counts: P:" << p << " A:" << a << " L:" << l << " (checksum " << checksum << ")\n";
+#ifdef ATTENDANCE_X86_DISPATCH
+    cout << "Popcount kernel: " << (__builtin_cpu_supports("avx2") ? "AVX2" : "portable") << "\n";
+#else
+    cout << "Popcount kernel: portable\n";
+#endif
+    cout << fixed << setprecision(1);
+    cout << "map walk:          " << mapNs << " ns/summary\n";
+    cout << "bitplane popcount: " << bitsNs << " ns/summary\n";
+    cout << "speedup:           " << (bitsNs > 0 ? mapNs / bitsNs : 0) << "x\n";
+}
+
+// Compare the old getline/substr/stoi parsing with the string_view parser
+// on a generated students.txt and a legacy session text file of the same
+// number of rows
+void runParseBenchmark(int rows) {
+    string studentPath = (fs::temp_directory_path() / "bench_students.txt").string();
+    string sessionPath = (fs::temp_directory_path() / "bench_session.txt").string();
+    {
+        ofstream studentOut(studentPath);
+        ofstream sessionOut(sessionPath);
+        sessionOut << "COURSE:BENCH101\nDATE:2025-01-01\nTIME:08:00\nDURATION:2\nSTUDENTS:" << rows << "\n";
+        for(int i = 0; i < rows; i++) {
+            studentOut << "STU" << i << ",Student Number " << i << "\n";
+            sessionOut << "INDEX:STU" << i << "\n";
+        }
+        sessionOut << "ATTENDANCE:" << rows << "\n";
+        for(int i = 0; i < rows; i++) {
+            sessionOut << "STU" << i << ":" << i % 3 << "\n";
+        }
+    }
+    
+    auto rate = [&](double seconds, size_t records) { return seconds > 0 ? records / seconds : 0; };
+    size_t checksum = 0;
+    
+    // students.txt: getline and Student::fromCSV's old substr copies
+    auto start = chrono::steady_clock::now();
+    {
+        ifstream file(studentPath);
+        string line;
+        while(getline(file, line)) {
+            size_t comma = line.find(',');
+            if(comma == string::npos) continue;
+            string idx = line.substr(0, comma);
+            string name = line.substr(comma + 1);
+            checksum += idx.size() + name.size();
+        }
+    }
+    double oldStudents = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    
+    start = chrono::steady_clock::now();
+    {
+        string text;
+        readWholeFile(studentPath, text);
+        LineReader reader(text);
+        string_view line;
+        while(reader.next(line)) {
+            size_t comma = line.find(',');
+            if(comma == string_view::npos) continue;
+            checksum += comma + (line.size() - comma - 1);
+        }
+    }
+    double newStudents = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    
+    // Legacy session text: header/value substrings and stoi per line
+    start = chrono::steady_clock::now();
+    {
+        ifstream file(sessionPath);
+        string line;
+        while(getline(file, line)) {
+            size_t colon = line.find(':');
+            if(colon == string::npos) continue;
+            string header = line.substr(0, colon);
+            string value = line.substr(colon + 1);
+            if(header != "INDEX" && header != "COURSE" && header != "DATE" && header != "TIME") {
+                checksum += stoi(value);
+            }
+            checksum += header.size();
+        }
+    }
+    double oldSession = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    
+    start = chrono::steady_clock::now();
+    {
+        string text;
+        readWholeFile(sessionPath, text);
+        LineReader reader(text);
+        string_view line;
+        while(reader.next(line)) {
+            size_t colon = line.find(':');
+            if(colon == string_view::npos) continue;
+            string_view header = line.substr(0, colon);
+            string_view value = line.substr(colon + 1);
+            int number;
+            if(header != "INDEX" && header != "COURSE" && header != "DATE" && header != "TIME"
+               && parseNumber(value, number)) {
+                checksum += number;
+            }
+            checksum += header.size();
+        }
+    }
+    double newSession = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    
+    remove(studentPath.c_str());
+    remove(sessionPath.c_str());
+    
+    size_t sessionLines = 2 * static_cast<size_t>(rows) + 6;
+    cout << rows << " students, session file of " << sessionLines << " lines (checksum " << checksum << ")\n";
+    cout << fixed << setprecision(0);
+    cout << "students.txt   getline/substr: " << rate(oldStudents, rows) << " records/s\n";
+    cout << "students.txt   string_view:    " << rate(newStudents, rows) << " records/s\n";
+    cout << "session text   getline/stoi:   " << rate(oldSession, sessionLines) << " records/s\n";
+    cout << "session text   from_chars:     " << rate(newSession, sessionLines) << " records/s\n";
+    cout << setprecision(1);
+    cout << "speedup: " << (newStudents > 0 ? oldStudents / newStudents : 0) << "x students, "
+         << (newSession > 0 ? oldSession / newSession : 0) << "x session text\n";
+}
+
+// Time loading a generated students.txt: the per-line getline/fromCSV
+// path against the bulk loader, single-threaded and with the load threads
+void runStudentLoadBenchmark(int rows) {
+    string path = (fs::temp_directory_path() / "bench_students.txt").string();
+    {
+        ofstream out(path);
+        for(int i = 0; i < rows; i++) {
+            out << "UG" << 1000000 + i << ",Student Number " << i << "\n";
+        }
+    }
+    
+    auto start = chrono::steady_clock::now();
+    size_t lineLoaded;
+    {
+        StudentRegistry registry;
+        ifstream file(path);
+        string line;
+        while(getline(file, line)) {
+            if(!line.empty()) registry.insert(Student::fromCSV(line));
+        }
+        lineLoaded = registry.size();
+    }
+    double lineSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    
+    unsigned threadCount = loadThreads > 0 ? loadThreads : thread::hardware_concurrency();
+    if(threadCount == 0) threadCount = 1;
+    auto timeBulk = [&](unsigned threads, size_t& loaded) {
+        auto bulkStart = chrono::steady_clock::now();
+        StudentRegistry registry;
+        string text;
+        vector<ParseError> errors;
+        readWholeFile(path, text);
+        loadStudentsBulk(text, registry, errors, threads);
+        loaded = registry.size();
+        return chrono::duration<double>(chrono::steady_clock::now() - bulkStart).count();
+    };
+    size_t bulkLoaded, parallelLoaded;
+    double bulkSeconds = timeBulk(1, bulkLoaded);
+    double parallelSeconds = timeBulk(threadCount, parallelLoaded);
+    
+    // Delimiter scan alone, portable against the selected kernel
+    string text;
+    readWholeFile(path, text);
+    remove(path.c_str());
+    const char* kernelName;
+    DelimiterKernel kernel = selectDelimiterKernel(&kernelName);
+    auto timeScan = [&](DelimiterKernel scan) {
+        auto scanStart = chrono::steady_clock::now();
+        uint64_t found = 0;
+        for(size_t pos = 0; pos + 64 <= text.size(); pos += 64) {
+            DelimiterMasks masks = scan(text.data() + pos, 64);
+            found += __builtin_popcountll(masks.newlines) + __builtin_popcountll(masks.commas);
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - scanStart).count();
+        return make_pair(seconds, found);
+    };
+    auto portableScan = timeScan(delimiterMasksPortable);
+    auto kernelScan = timeScan(kernel);
+    
+    cout << rows << " students, " << text.size() << " bytes (loaded " << lineLoaded << "/" << bulkLoaded
+         << "/" << parallelLoaded << ", delimiters " << portableScan.second << "/" << kernelScan.second << ")\n";
+    cout << fixed << setprecision(1);
+    cout << "getline + fromCSV:          " << lineSeconds * 1000 << " ms\n";
+    cout << "bulk loader, 1 thread:      " << bulkSeconds * 1000 << " ms\n";
+    cout << "bulk loader, " << threadCount << " thread(s):   " << parallelSeconds * 1000 << " ms\n";
+    cout << "delimiter scan, portable:   " << text.size() / portableScan.first / 1e9 << " GB/s\n";
+    cout << "delimiter scan, " << kernelName << ":" << string(max<int>(1, 11 - static_cast<int>(strlen(kernelName))), ' ')
+         << text.size() / kernelScan.first / 1e9 << " GB/s\n";
+}
+
+// Scratch directory for the durable-write tools; removed afterwards
+string makeScratchDirectory(const string& prefix) {
+    string pattern = prefix + "_XXXXXX";
+    vector<char> name(pattern.begin(), pattern.end());
+    name.push_back('\0');
+    return mkdtemp(name.data()) != nullptr ? string(name.data()) : "";
+}
+
+// Micro-benchmark: saving many files in place with one fsync each, through
+// a temporary file and rename one at a time, and as one group commit
+void runDurableWriteBenchmark(int files, int fileBytes) {
+    string dir = makeScratchDirectory("durable_bench");
+    if(dir.empty()) {
+        cout << "✗ Error: Could not create a scratch directory\n";
+        return;
+    }
+    string contents(static_cast<size_t>(fileBytes), 'x');
+    auto fileName = [&](int i) { return dir + "/file_" + to_string(i) + ".txt"; };
+    
+    auto inPlaceStart = chrono::steady_clock::now();
+    for(int i = 0; i < files; i++) {
+        int fd = open(fileName(i).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        writeFully(fd, contents.data(), contents.size());
+        fsync(fd);
+        close(fd);
+    }
+    double inPlaceSeconds = chrono::duration<double>(chrono::steady_clock::now() - inPlaceStart).count();
+    
+    auto singleStart = chrono::steady_clock::now();
+    for(int i = 0; i < files; i++) {
+        writeFileDurably(fileName(i), contents);
+    }
+    double singleSeconds = chrono::duration<double>(chrono::steady_clock::now() - singleStart).count();
+    
+    auto groupStart = chrono::steady_clock::now();
+    GroupCommit commit;
+    for(int i = 0; i < files; i++) {
+        commit.replace(fileName(i), contents);
+    }
+    bool committed = commit.commit();
+    double groupSeconds = chrono::duration<double>(chrono::steady_clock::now() - groupStart).count();
+    
+    fs::remove_all(dir);
+    cout << files << " files of " << fileBytes << " bytes" << (committed ? "" : " (group commit failed)") << "\n";
+    cout << fixed << setprecision(1);
+    cout << "in place, fsync per file:      " << inPlaceSeconds * 1000 << " ms (not crash-safe)\n";
+    cout << "temp + rename, one at a time:  " << singleSeconds * 1000 << " ms\n";
+    cout << "temp + rename, group commit:   " << groupSeconds * 1000 << " ms ("
+         << setprecision(2) << (groupSeconds > 0 ? singleSeconds / groupSeconds : 0) << "x)\n";
+    cout.unsetf(ios::fixed);
+    cout << setprecision(6);
+}
+
+// Micro-benchmark of mass session reads and writes in a scratch session
+// store: one system call per record as before, the same records as one
+// blocking batch, and as one io_uring batch when built with
+// -DATTENDANCE_USE_IO_URING. Syscalls are the reads and writes issued
+// (io_uring_enter for the ring); the store sync is timed but not counted.
+void runBatchIoBenchmark(int sessionCount) {
+    string dir = makeScratchDirectory("batch_io_bench");
+    SessionStore store;
+    if(dir.empty() || sessionCount <= 0 || !store.open(dir + "/sessions.dat", dir + "/sessions.idx")) {
+        cout << "✗ Error: Could not create a scratch session store\n";
+        if(!dir.empty()) fs::remove_all(dir);
+        return;
+    }
+    
+    // Sessions of 300 students with random marks, encoded once
+    StudentRegistry registry;
+    for(int k = 0; k < 300; k++) {
+        registry.insert(Student("UG" + to_string(100000 + k), "Student " + to_string(k)));
+    }
+    mt19937 rng(42);
+    vector<string> records(static_cast<size_t>(sessionCount));
+    vector<SessionStore::RecordWrite> writes;
+    for(int i = 0; i < sessionCount; i++) {
+        // 50 courses, each on distinct days
+        char date[16];
+        snprintf(date, sizeof(date), "2026-%02d-%02d", 1 + i / 50 / 28 % 12, 1 + i / 50 % 28);
+        AttendanceSession session("BEN" + to_string(100 + i % 50), date, i / 50 / 336 % 2 == 0 ? "08:00" : "14:00", "2");
+        session.addAllStudents(registry);
+        for(uint32_t id : session.getRosterIds()) {
+            session.markAttendance(id, static_cast<AttendanceStatus>(rng() % 3));
+        }
+        session.encodeBinary(records[i]);
+        writes.push_back({&records[i], session.getCourseCode(), session.getDate(), session.getStartTime(), session.getDuration(), 0});
+    }
+    store.writeRecords(writes, nullptr);
+    store.sync(nullptr);
+    vector<int> slots = store.liveEntries();
+    size_t bytes = 0;
+    for(const auto& record : records) bytes += record.size();
+    
+    struct Mode {
+        const char* name;
+        bool batched;
+        bool ring;
+    };
+    vector<Mode> modes = {{"one call per record", false, false}, {"batch, blocking", true, false}};
+#ifdef ATTENDANCE_USE_IO_URING
+    modes.push_back({"batch, io_uring", true, true});
+#endif
+    
+    cout << sessionCount << " sessions (" << slots.size() << " stored), " << bytes / 1024 << " KB of records\n";
+    cout << left << setw(22) << "mode" << right << setw(12) << "read ms" << setw(12) << "syscalls"
+         << setw(12) << "write ms" << setw(12) << "syscalls" << "\n";
+    bool ringWanted = batchIoUseRing;
+    for(const Mode& mode : modes) {
+        batchIoUseRing = mode.ring;
+        if(mode.ring && strcmp(BatchIo::backend(), "io_uring") != 0) {
+            cout << left << setw(22) << mode.name << "  io_uring is not available here\n";
+            continue;
+        }
+        
+        // Both read into one buffer per record, as a mass load would
+        vector<string> buffers;
+        vector<char> ok;
+        unsigned long before = batchIoSyscalls;
+        auto readStart = chrono::steady_clock::now();
+        if(mode.batched) {
+            store.readRecords(slots, buffers, ok);
+        } else {
+            vector<string> all(slots.size());
+            for(size_t i = 0; i < slots.size(); i++) {
+                store.readRecords({slots[i]}, buffers, ok);
+                all[i].swap(buffers[0]);
+            }
+        }
+        double readSeconds = chrono::duration<double>(chrono::steady_clock::now() - readStart).count();
+        unsigned long readCalls = batchIoSyscalls - before;
+        
+        // Rewriting unchanged layouts goes in place: a compare read and two writes per record
+        before = batchIoSyscalls;
+        auto writeStart = chrono::steady_clock::now();
+        if(mode.batched) {
+            store.writeRecords(writes, nullptr);
+        } else {
+            for(const auto& write : writes) store.writeRecords({write}, nullptr);
+        }
+        store.sync(nullptr);
+        double writeSeconds = chrono::duration<double>(chrono::steady_clock::now() - writeStart).count();
+        unsigned long writeCalls = batchIoSyscalls - before;
+        
+        cout << left << setw(22) << mode.name << right << fixed << setprecision(1) << setw(12) << readSeconds * 1000
+             << setw(12) << readCalls << setw(12) << writeSeconds * 1000 << setw(12) << writeCalls << "\n";
+        cout.unsetf(ios::fixed);
+        cout << setprecision(6);
+    }
+    batchIoUseRing = ringWanted;
+#ifndef ATTENDANCE_USE_IO_URING
+    cout << "(io_uring not compiled in; rebuild with -DATTENDANCE_USE_IO_URING to compare it)\n";
+#endif
+    store.close();
+    fs::remove_all(dir);
+}
+
+// Fault-injection test of the durable save: a child process group-commits
+// new contents over a set of files and is killed with SIGKILL after each
+// possible file step in turn (ATTENDANCE_FAULT_AFTER_FILES). After every
+// crash each file must hold exactly its old or its new contents, and the
+// files must switch in commit order. The session store is tested the same
+// way by runStoreCrashTest.
+int runCrashTest(int files) {
+    string dir = makeScratchDirectory("crash_test");
+    if(dir.empty() || files <= 0) {
+        cout << "✗ Error: Could not create a scratch directory\n";
+        return 1;
+    }
+    auto fileName = [&](int i) { return dir + "/file_" + to_string(i) + ".txt"; };
+    auto contentsFor = [](int i, const char* version) {
+        return string(version) + " contents of file " + to_string(i) + "\n" + string(4096 + i * 97, version[0]);
+    };
+    
+    // A commit takes two steps per file (temporary written, renamed); the
+    // last fault point lets the commit finish
+    int failures = 0;
+    int steps = 2 * files;
+    for(int faultAfter = 0; faultAfter <= steps; faultAfter++) {
+        for(int i = 0; i < files; i++) {
+            writeFileDurably(fileName(i), contentsFor(i, "old"));
+        }
+        
+        pid_t child = fork();
+        if(child < 0) {
+            cout << "✗ Error: fork failed\n";
+            return 1;
+        }
+        if(child == 0) {
+            setenv("ATTENDANCE_FAULT_AFTER_FILES", to_string(faultAfter).c_str(), 1);
+            durableStepsDone = 0;
+            GroupCommit commit;
+            for(int i = 0; i < files; i++) {
+                commit.replace(fileName(i), contentsFor(i, "new"));
             }
+            _exit(commit.commit() ? 0 : 1);
         }
+        int status = 0;
+        waitpid(child, &status, 0);
+        bool killed = WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL;
         
-        AttendanceStatus status = session.getAttendanceStatus(index);
-        cout << left << setw(15) << index 
-             << setw(30) << studentName 
-             << "[" << statusToChar(status) << "] " << statusToString(status) << endl;
+        int newFiles = 0;
+        bool consistent = true;
+        for(int i = 0; i < files; i++) {
+            string text;
+            readWholeFile(fileName(i), text);
+            if(text == contentsFor(i, "new")) {
+                if(newFiles != i) consistent = false;
+                newFiles++;
+            } else if(text != contentsFor(i, "old")) {
+                consistent = false;
+            }
+        }
+        bool expectKill = faultAfter < steps;
+        if(!consistent || killed != expectKill) {
+            failures++;
+            cout << "✗ Crash after " << faultAfter << " step(s): "
+                 << (consistent ? "process was not killed as expected" : "a file is torn or out of order") << "\n";
+        } else {
+            cout << "✓ Crash after " << faultAfter << " step(s): " << newFiles << " of " << files << " files new, "
+                 << files - newFiles << " old\n";
+        }
+    }
+    fs::remove_all(dir);
+    if(failures == 0) {
+        cout << "✓ All " << steps + 1 << " crash points left every file intact.\n";
+    }
+    return runStoreCrashTest() == 0 && failures == 0 ? 0 : 1;
+}
+
+// Status a student has in a crash-test session before (PRESENT) and after
+// the save that is interrupted
+AttendanceStatus crashTestStatus(uint32_t student, size_t session, bool after) {
+    if(!after) return PRESENT;
+    return static_cast<AttendanceStatus>((student + session) % 3);
+}
+
+// Session store crash test. A child process loads a small store, changes
+// every mark of its sessions (rewritten in place) and adds a session
+// (appended), then runs saveDirtySessions and is killed after each file
+// step in turn. Another child reopens the store, which replays the
+// double-write buffer, and checks that every record passes its checksum,
+// that the counts cached in the index match the marks, and that each
+// session holds all of its old or all of its new marks.
+int runStoreCrashTest() {
+    const size_t studentCount = 40;
+    const size_t sessionCount = 6;
+    const string newSession = "CRASHNEW";
+    string dir = makeScratchDirectory("store_crash_test");
+    if(dir.empty()) {
+        cout << "✗ Error: Could not create a scratch directory\n";
+        return 1;
+    }
+    string saved = dir + "/saved";
+    string work = dir + "/work";
+    
+    // Runs body in a child process in directory, with the core's output
+    // silenced; returns its exit status
+    auto inChild = [](const string& directory, const function<int()>& body) {
+        cout.flush();
+        pid_t child = fork();
+        if(child == 0) {
+            fs::current_path(directory);
+            streambuf* console = cout.rdbuf(nullptr);
+            int code = body();
+            cout.rdbuf(console);
+            cout.flush();
+            _exit(code);
+        }
+        int status = 0;
+        if(child > 0) waitpid(child, &status, 0);
+        return status;
+    };
+    
+    fs::create_directory(saved);
+    int setup = inChild(saved, [&]() {
+        if(coreOpen() != CORE_OK) return 1;
+        for(size_t k = 0; k < studentCount; k++) {
+            coreRegisterStudent("CT" + to_string(1000 + k), "Crash Test " + to_string(k));
+        }
+        for(size_t i = 0; i < sessionCount; i++) {
+            size_t position;
+            if(coreCreateSession("CRASH" + to_string(100 + i), "2025-03-01", "08:00", "2", &position) != CORE_OK) return 1;
+            vector<pair<string, AttendanceStatus>> marks;
+            for(size_t k = 0; k < studentCount; k++) {
+                marks.push_back({"CT" + to_string(1000 + k), crashTestStatus(static_cast<uint32_t>(k), i, false)});
+            }
+            if(coreMarkAttendance(position, marks) != CORE_OK) return 1;
+        }
+        return coreClose() == CORE_OK ? 0 : 1;
+    });
+    if(!WIFEXITED(setup) || WEXITSTATUS(setup) != 0) {
+        cout << "✗ Error: Could not set up the session store for the crash test\n";
+        fs::remove_all(dir);
+        return 1;
     }
     
-    cout << "------------------------------------------------\n";
+    int failures = 0;
+    int faultAfter = 0;
+    for(bool killed = true; killed && faultAfter < 64; faultAfter++) {
+        fs::remove_all(work);
+        fs::copy(saved, work);
+        int crash = inChild(work, [&]() {
+            if(coreOpen() != CORE_OK) return 1;
+            for(auto& session : sessions) {
+                if(!touchSession(session)) return 1;
+            }
+            lock_guard<mutex> lock(dataMutex);
+            size_t count = sessions.size();
+            for(size_t i = 0; i < count; i++) {
+                for(uint32_t id : sessions[i].getRosterIds()) {
+                    sessions[i].markAttendance(id, crashTestStatus(id, i, true));
+                }
+            }
+            AttendanceSession added(newSession, "2025-03-02", "08:00", "2");
+            added.addAllStudents(students);
+            for(uint32_t id : added.getRosterIds()) added.markAttendance(id, crashTestStatus(id, count, true));
+            sessions.push_back(move(added));
+            
+            setenv("ATTENDANCE_FAULT_AFTER_FILES", to_string(faultAfter).c_str(), 1);
+            durableStepsDone = 0;
+            bool allSaved = false;
+            saveDirtySessions(false, &allSaved);
+            return allSaved ? 0 : 1;
+        });
+        killed = WIFSIGNALED(crash) && WTERMSIG(crash) == SIGKILL;
+        if(!killed && (!WIFEXITED(crash) || WEXITSTATUS(crash) != 0)) {
+            failures++;
+            cout << "✗ Store crash after " << faultAfter << " step(s): the save failed without a crash\n";
+            continue;
+        }
+        
+        // Exit status: sessions found new, plus 64 if writes were replayed
+        int check = inChild(work, [&]() {
+            if(coreOpen() != CORE_OK) return 254;
+            long replayed = sessionStore.recoveredWrites();
+            size_t newCount = 0;
+            string problem;
+            for(size_t i = 0; i < sessions.size() && problem.empty(); i++) {
+                AttendanceSession& session = sessions[i];
+                int cachedP, cachedA, cachedL, p, a, l;
+                session.getSummary(cachedP, cachedA, cachedL);
+                if(!touchSession(session)) {
+                    problem = session.getRecordName() + " cannot be read (checksum)";
+                    break;
+                }
+                session.getSummary(p, a, l);
+                if(p != cachedP || a != cachedA || l != cachedL) {
+                    problem = session.getRecordName() + " has index counts that disagree with its marks";
+                    break;
+                }
+                size_t number = session.getCourseCode() == newSession ? sessionCount
+                                                                      : static_cast<size_t>(stoi(session.getCourseCode().substr(5))) - 100;
+                size_t oldMarks = 0, newMarks = 0;
+                for(uint32_t id : session.getRosterIds()) {
+                    AttendanceStatus status = session.getAttendanceStatus(id);
+                    if(status == crashTestStatus(id, number, false)) oldMarks++;
+                    if(status == crashTestStatus(id, number, true)) newMarks++;
+                }
+                size_t roster = session.getRosterIds().size();
+                if(newMarks == roster) newCount++;
+                else if(oldMarks != roster) problem = session.getRecordName() + " mixes old and new marks";
+            }
+            if(!problem.empty()) {
+                cerr << "  " << problem << "\n";
+                return 255;
+            }
+            return static_cast<int>(newCount + (replayed > 0 ? 64 : 0));
+        });
+        int code = WIFEXITED(check) ? WEXITSTATUS(check) : 255;
+        if(code >= 254) {
+            failures++;
+            cout << "✗ Store crash after " << faultAfter << " step(s): the reloaded store is inconsistent\n";
+        } else {
+            cout << "✓ Store crash after " << faultAfter << " step(s): " << code % 64 << " of " << sessionCount + 1
+                 << " sessions new" << (code >= 64 ? ", torn writes repaired from the double-write buffer" : "") << "\n";
+        }
+    }
+    fs::remove_all(dir);
+    if(failures == 0) {
+        cout << "✓ All " << faultAfter << " store crash points left every session intact.\n";
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+// Benchmark suite. Generates a synthetic data set (students.txt plus
+// legacy session_*.txt files) in its own directory, times the core paths
+// on it and writes the results as JSON for tracking across releases:
+//   bench [--students N] [--sessions M] [--roster R] [--courses C]
+//         [--dir DIR] [--out FILE]
+struct BenchResult {
+    string name;
+    double seconds;
+    size_t operations;
+};
+
+// Silences cout while a timed step runs
+class QuietOutput {
+private:
+    streambuf* saved;
+    
+public:
+    QuietOutput() : saved(cout.rdbuf(nullptr)) {}
+    ~QuietOutput() { cout.rdbuf(saved); }
+};
+
+string benchIndexNumber(size_t k) {
+    return "UG" + to_string(1000000 + k);
+}
+
+// Course, date and start time of generated session i; unique per i
+void benchSessionKey(size_t i, size_t courses, string& course, string& date, string& time) {
+    size_t day = i / courses;
+    char dateText[16], timeText[8];
+    snprintf(dateText, sizeof(dateText), "%04zu-%02zu-%02zu", 2025 + day / 3360 % 2, 1 + day / 28 % 12, 1 + day % 28);
+    snprintf(timeText, sizeof(timeText), "%02zu:00", 8 + day / 336 % 10);
+    course = "BEN" + to_string(100 + i % courses);
+    date = dateText;
+    time = timeText;
+}
+
+void writeBenchSessionFile(const string& filename, size_t i, size_t studentCount, size_t roster, size_t courses, mt19937& rng) {
+    string course, date, time;
+    benchSessionKey(i, courses, course, date, time);
+    size_t cohort = (i % courses) * roster;
+    string text = "COURSE:" + course + "\nDATE:" + date + "\nTIME:" + time + "\nDURATION:2\nSTUDENTS:" + to_string(roster) + "\n";
+    for(size_t j = 0; j < roster; j++) {
+        text += "INDEX:" + benchIndexNumber((cohort + j) % studentCount) + "\n";
+    }
+    text += "ATTENDANCE:" + to_string(roster) + "\n";
+    for(size_t j = 0; j < roster; j++) {
+        text += benchIndexNumber((cohort + j) % studentCount) + ":" + to_string(rng() % 3) + "\n";
+    }
+    ofstream out(filename, ios::binary);
+    out << text;
+}
+
+int runBenchSuite(const vector<string>& args) {
+    size_t studentCount = 10000, sessionCount = 1000, roster = 100, courses = 20;
+    string dir = "attendance_bench", outFile = "bench_results.json";
+    for(size_t i = 1; i + 1 < args.size(); i += 2) {
+        if(args[i] == "--students") studentCount = stoul(args[i + 1]);
+        else if(args[i] == "--sessions") sessionCount = stoul(args[i + 1]);
+        else if(args[i] == "--roster") roster = stoul(args[i + 1]);
+        else if(args[i] == "--courses") courses = stoul(args[i + 1]);
+        else if(args[i] == "--dir") dir = args[i + 1];
+        else if(args[i] == "--out") outFile = args[i + 1];
+    }
+    if(args.size() % 2 != 1 || studentCount == 0 || sessionCount == 0 || courses == 0) {
+        cout << "Usage: bench [--students N] [--sessions M] [--roster R] [--courses C] [--dir DIR] [--out FILE]\n";
+        return 2;
+    }
+    roster = min(roster, studentCount);
+    
+    // The directory is wiped first, so only one this command created
+    // (marked by BENCH_MARKER) may be reused
+    const string BENCH_MARKER = ".attendance_bench";
+    error_code ec;
+    fs::path outPath = fs::absolute(outFile, ec);
+    if(fs::exists(dir) && !fs::exists(fs::path(dir) / BENCH_MARKER)) {
+        cout << "✗ Error: " << dir << " already exists and was not created by bench; choose another --dir\n";
+        return 1;
+    }
+    fs::remove_all(dir, ec);
+    fs::create_directories(fs::path(dir) / "legacy", ec);
+    ofstream(fs::path(dir) / BENCH_MARKER);
+    fs::path home = fs::current_path();
+    fs::current_path(dir, ec);
+    if(ec) {
+        cout << "✗ Error: Could not use directory " << dir << endl;
+        return 1;
+    }
     
-    int present, absent, late;
-    session.getSummary(present, absent, late);
-    int total = present + absent + late;
+    vector<BenchResult> results;
+    auto timed = [&](const string& name, size_t operations, const function<void()>& step) {
+        auto start = chrono::steady_clock::now();
+        {
+            QuietOutput quiet;
+            step();
+        }
+        results.push_back({name, chrono::duration<double>(chrono::steady_clock::now() - start).count(), operations});
+    };
+    
+    // Synthetic data: students.txt, the session files for migration and a
+    // separate copy of the first few for the per-file load timing
+    const size_t legacySample = min<size_t>(sessionCount, 200);
+    mt19937 rng(42);
+    timed("generate", studentCount + sessionCount, [&]() {
+        string text;
+        for(size_t k = 0; k < studentCount; k++) {
+            text += benchIndexNumber(k) + ",Student Number " + to_string(k) + "\n";
+        }
+        ofstream(STUDENT_FILE, ios::binary) << text;
+        for(size_t i = 0; i < sessionCount; i++) {
+            writeBenchSessionFile("session_" + to_string(100000 + i) + ".txt", i, studentCount, roster, courses, rng);
+        }
+        for(size_t i = 0; i < legacySample; i++) {
+            writeBenchSessionFile("legacy/session_" + to_string(i) + ".txt", i, studentCount, roster, courses, rng);
+        }
+    });
     
-    cout << "\nSUMMARY:\n";
-    cout << "Total Students: " << total << endl;
-    cout << "Present: " << present << " (" << fixed << setprecision(1) 
-         << (total > 0 ? (present * 100.0 / total) : 0) << "%)\n";
-    cout << "Absent: " << absent << " (" << (total > 0 ? (absent * 100.0 / total) : 0) << "%)\n";
-    cout << "Late: " << late << " (" << (total > 0 ? (late * 100.0 / total) : 0) << "%)\n";
-    cout << "========================================\n";
-}
\ No newline at end of file
+    timed("load_all_data_migrate", sessionCount, []() { loadAllData(); });
+    timed("save_all_data_clean", sessions.size(), []() { coreSave(); coreFlush(); });
+    
+    timed("load_from_file_legacy", legacySample, [&]() {
+        for(size_t i = 0; i < legacySample; i++) {
+            AttendanceSession session;
+            session.loadFromFile("legacy/session_" + to_string(i) + ".txt", students);
+        }
+    });
+    
+    // Mark every student on a run of sessions through the core API, one
+    // journal batch each, as the menu does; operations are individual marks
+    const size_t markSessions = min<size_t>(sessions.size(), 50);
+    size_t marks = 0;
+    timed("mark_full_session", markSessions, [&]() {
+        for(size_t i = 0; i < markSessions; i++) {
+            touchSession(sessions[i]);
+            vector<pair<string, AttendanceStatus>> batch;
+            for(uint32_t id : sessions[i].getRosterIds()) {
+                batch.push_back({students[id].getIndexNumber(), static_cast<AttendanceStatus>(rng() % 3)});
+            }
+            coreMarkAttendance(i, batch);
+            marks += batch.size();
+        }
+        coreFlush();
+    });
+    results.back().operations = marks;
+    
+    // Registration and session creation through the core API. Every new
+    // session rosters all students, so only a few are created.
+    const size_t newStudents = min<size_t>(studentCount, 10000);
+    timed("api_register_student", newStudents, [&]() {
+        for(size_t k = 0; k < newStudents; k++) {
+            coreRegisterStudent(benchIndexNumber(studentCount + k), "New Student " + to_string(k));
+        }
+    });
+    const size_t newSessions = min<size_t>(sessionCount, 10);
+    timed("api_create_session", newSessions, [&]() {
+        for(size_t i = 0; i < newSessions; i++) {
+            coreCreateSession("NEW" + to_string(100 + i), "2026-12-01", "08:00", "2");
+        }
+        coreFlush();
+    });
+    
+    timed("save_all_data_dirty", markSessions + newSessions, []() { coreSave(); coreFlush(); });
+    
+    timed("save_to_store", markSessions, [&]() {
+        for(size_t i = 0; i < markSessions; i++) {
+            sessions[i].saveToStore(sessionStore);
+        }
+        sessionStore.sync(nullptr);
+    });
+    
+    const size_t summaryCalls = 1000000;
+    timed("get_summary", summaryCalls, [&]() {
+        AttendanceSession& session = sessions[0];
+        touchSession(session);
+        long long checksum = 0;
+        int p, a, l;
+        for(size_t i = 0; i < summaryCalls; i++) {
+            session.getSummary(p, a, l);
+            checksum += p + a + l;
+        }
+        if(checksum == 42) cout << checksum;
+    });
+    
+    vector<size_t> everything = sessionIndex.all();
+    timed("report_session_text", 1, [&]() {
+        ReportWriter report("report_session.txt");
+        touchSession(sessions[0]);
+        renderSessionReport(sessions[0], report);
+    });
+    timed("report_semester_csv", everything.size(), [&]() {
+        ReportWriter report("report_semester.csv");
+        renderSemesterReport(everything, "2024-01-01", "2026-12-31", report);
+    });
+    timed("report_semester_html", everything.size(), [&]() {
+        ReportWriter report("report_semester.html");
+        renderSemesterReport(everything, "2024-01-01", "2026-12-31", report);
+    });
+    
+    // A fresh start now that everything is in the session store. The
+    // writer and compactor hold on to the data being reset, so the core is
+    // closed first and the compactor started again once reloaded; the
+    // writer restarts by itself on its next snapshot.
+    size_t storedSessions = sessions.size();
+    CoreResult closed;
+    {
+        QuietOutput quiet;
+        closed = coreClose();
+    }
+    if(closed != CORE_OK) {
+        cout << "✗ Error: Could not save the benchmark data\n";
+        fs::current_path(home, ec);
+        return 1;
+    }
+    {
+        lock_guard<mutex> lock(dataMutex);
+        students = StudentRegistry();
+        sessions.clear();
+        residentSessions.clear();
+        sessionIndex.clear();
+        sessionStore.close();
+    }
+    timed("load_all_data_store", storedSessions, []() { loadAllData(); });
+    compactor.start();
+    timed("fault_in_all_sessions", sessions.size(), []() {
+        for(auto& session : sessions) {
+            touchSession(session);
+        }
+    });
+    {
+        QuietOutput quiet;
+        coreClose();
+    }
+    
+    fs::current_path(home, ec);
+    
+    string json = "{\n  \"benchmark\": \"attendance\",\n  \"timestamp\": " + to_string(time(nullptr))
+                + ",\n  \"students\": " + to_string(studentCount) + ",\n  \"sessions\": " + to_string(sessionCount)
+                + ",\n  \"roster\": " + to_string(roster) + ",\n  \"courses\": " + to_string(courses)
+                + ",\n  \"threads\": " + to_string(loadThreads > 0 ? loadThreads : thread::hardware_concurrency())
+                + ",\n  \"results\": [\n";
+    cout << left << setw(24) << "step" << right << setw(12) << "ms" << setw(12) << "ops" << setw(16) << "ops/s" << "\n";
+    for(size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        double rate = r.seconds > 0 ? r.operations / r.seconds : 0;
+        char line[256];
+        snprintf(line, sizeof(line), "    {\"name\": \"%s\", \"seconds\": %.6f, \"operations\": %zu, \"ops_per_second\": %.1f}%s\n",
+                 r.name.c_str(), r.seconds, r.operations, rate, i + 1 < results.size() ? "," : "");
+        json += line;
+        cout << left << setw(24) << r.name << right << fixed << setprecision(1) << setw(12) << r.seconds * 1000
+             << setw(12) << r.operations << setw(16) << setprecision(0) << rate << "\n";
+    }
+    json += "  ]\n}\n";
+    cout << left;
+    
+    ofstream out(outPath, ios::binary);
+    out << json;
+    if(!out) {
+        cout << "✗ Error: Could not write " << outPath.string() << endl;
+        return 1;
+    }
+    cout << "✓ Results written to " << outPath.string() << endl;
+    return 0;
+}
+
+// Find a session from "COURSE/YYYY-MM-DD" or "COURSE/YYYY-MM-DD/HH:MM".
+// The start time may be left out when only one session matches.
+AttendanceSession* findSessionBySpec(const string& spec) {
+    vector<string> parts;
+    size_t start = 0;
+    size_t slash;
+    while((slash = spec.find('/', start)) != string::npos) {
+        parts.push_back(spec.substr(start, slash - start));
+        start = slash + 1;
+    }
+    parts.push_back(spec.substr(start));
+    if(parts.size() < 2 || parts.size() > 3) {
+        cout << "✗ Session must be given as COURSE/YYYY-MM-DD[/HH:MM]\n";
+        return nullptr;
+    }
+    
+    string courseCode = toUpperCase(parts[0]);
+    vector<AttendanceSession*> matches;
+    for(size_t position : sessionIndex.query(courseCode, false, parts[1], parts[1])) {
+        if(parts.size() == 2 || sessions[position].getStartTime() == parts[2]) {
+            matches.push_back(&sessions[position]);
+        }
+    }
+    if(matches.empty()) {
+        cout << "✗ No session found for " << spec << endl;
+        return nullptr;
+    }
+    if(matches.size() > 1) {
+        cout << "✗ " << spec << " matches " << matches.size() << " sessions; add the start time:\n";
+        for(auto* session : matches) {
+            cout << "  " << session->getCourseCode() << "/" << session->getDate() << "/" << session->getStartTime() << endl;
+        }
+        return nullptr;
+    }
+    return matches[0];
+}
+
+// Lock and load the data for a headless command and start the compactor,
+// as the menu does; false, with the reason printed, if that failed. The
+// command ends with coreClose.
+bool openForCommand() {
+    CoreResult opened = coreOpen();
+    if(opened == CORE_OK) return true;
+    cout << "✗ Error: " << coreResultMessage(opened) << endl;
+    if(opened != CORE_LOCKED) compactor.stop();
+    return false;
+}
+
+// Headless import of card-reader marks: a CSV of "index,status" rows.
+// Rows are validated like interactive input (status P, A or L); rows for
+// unknown students or students not on the session roster go to
+// <csvFile>.rejects with the reason. Accepted marks are journaled with
+// one fsync before they are applied, as interactive marks are, then the
+// session is persisted once; a crash in between loses nothing.
+int importMarksCommand(const string& sessionSpec, const string& csvFile) {
+    AttendanceSession* session = findSessionBySpec(sessionSpec);
+    if(session == nullptr) {
+        return 1;
+    }
+    if(!touchSession(*session)) {
+        cout << "✗ Error: Could not read session " << session->getRecordName() << " from " << SESSION_DATA_FILE << endl;
+        return 1;
+    }
+    
+    int fd = open(csvFile.c_str(), O_RDONLY);
+    if(fd < 0) {
+        cout << "✗ Error: Could not open " << csvFile << endl;
+        return 1;
+    }
+    
+    vector<uint8_t> onRoster(students.idCount(), 0);
+    for(uint32_t id : session->getRosterIds()) {
+        onRoster[id] = 1;
+    }
+    
+    auto start = chrono::steady_clock::now();
+    vector<pair<uint32_t, AttendanceStatus>> batch;
+    string rejects;
+    size_t lineNumber = 0;
+    int rejected = 0;
+    
+    auto reject = [&](string_view line, const char* reason) {
+        rejects += to_string(lineNumber) + "," + reason + "," + string(line) + "\n";
+        rejected++;
+    };
+    auto processLine = [&](string_view line) {
+        lineNumber++;
+        if(!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if(trimField(line).empty()) return;
+        
+        size_t comma = line.find(',');
+        if(comma == string_view::npos) {
+            reject(line, "missing status");
+            return;
+        }
+        string_view index = trimField(line.substr(0, comma));
+        string_view status = trimField(line.substr(comma + 1));
+        if(lineNumber == 1 && index.size() == 5 && toUpperCase(string(index)) == "INDEX") {
+            return; // header row
+        }
+        if(status.size() != 1 || !isValidStatusChar(status[0])) {
+            reject(line, "invalid status");
+            return;
+        }
+        int32_t id = students.findId(index);
+        if(id == StudentRegistry::NO_ID || !students.isRegistered(static_cast<uint32_t>(id))) {
+            reject(line, "unknown index");
+            return;
+        }
+        if(static_cast<size_t>(id) >= onRoster.size() || !onRoster[id]) {
+            reject(line, "not on session roster");
+            return;
+        }
+        batch.push_back({static_cast<uint32_t>(id), charToStatus(status[0])});
+    };
+    
+    // Stream the file in large blocks; a line cut by a block boundary is
+    // carried over to the next block
+    const size_t BLOCK_SIZE = 1 << 20;
+    vector<char> block(BLOCK_SIZE);
+    string carry;
+    ssize_t bytesRead;
+    while((bytesRead = read(fd, block.data(), BLOCK_SIZE)) > 0) {
+        string_view data(block.data(), static_cast<size_t>(bytesRead));
+        size_t newline = data.find('\n');
+        if(newline == string_view::npos) {
+            carry.append(data);
+            continue;
+        }
+        if(!carry.empty()) {
+            carry.append(data.substr(0, newline));
+            processLine(carry);
+            carry.clear();
+        } else {
+            processLine(data.substr(0, newline));
+        }
+        size_t pos = newline + 1;
+        while((newline = data.find('\n', pos)) != string_view::npos) {
+            processLine(data.substr(pos, newline - pos));
+            pos = newline + 1;
+        }
+        carry.assign(data.substr(pos));
+    }
+    close(fd);
+    if(bytesRead < 0) {
+        cout << "✗ Error: Could not read " << csvFile << endl;
+        return 1;
+    }
+    if(!carry.empty()) {
+        processLine(carry);
+    }
+    STAT_ADD(STAT_PARSE_ERRORS, rejected);
+    
+    // Journal, apply as one batch and persist once
+    bool journaled = true;
+    bool saved = true;
+    {
+        STAT_SCOPE(TIMER_MARK);
+        lock_guard<mutex> lock(dataMutex);
+        vector<JournalEntry> entries;
+        entries.reserve(batch.size());
+        long long now = static_cast<long long>(time(nullptr));
+        for(const auto& mark : batch) {
+            entries.push_back({session->getKey(), students[mark.first].getIndexNumber(), mark.second, now});
+        }
+        journaled = entries.empty() || journal.append(entries);
+        if(journaled) {
+            for(const auto& mark : batch) {
+                session->markAttendance(mark.first, mark.second);
+            }
+            saveDirtySessions(false, &saved);
+        }
+    }
+    if(!journaled) {
+        cout << "✗ Error: Could not write " << JOURNAL_FILE << "; no marks were imported.\n";
+        return 1;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    
+    string rejectFile = csvFile + ".rejects";
+    if(rejected > 0) {
+        ofstream file(rejectFile);
+        file << "line,reason,row\n" << rejects;
+    }
+    
+    int p, a, l;
+    session->getSummary(p, a, l);
+    cout << "✓ Imported " << batch.size() << " marks into " << session->getRecordName()
+         << " (" << lineNumber << " rows in " << fixed << setprecision(1) << seconds * 1000 << " ms, "
+         << setprecision(0) << (seconds > 0 ? lineNumber / seconds : 0) << " rows/s).\n";
+    cout << "Present: " << p << " | Absent: " << a << " | Late: " << l << endl;
+    if(rejected > 0) {
+        cout << "✗ " << rejected << " row(s) rejected, see " << rejectFile << endl;
+    }
+    if(!saved) {
+        cout << "✗ Error: Could not save the session; the marks are kept in " << JOURNAL_FILE
+             << " and applied at the next start.\n";
+        return 1;
+    }
+    return 0;
+}
+
+// A tap-in from the turnstile bridge: student ID and seconds since midnight
+struct TapEvent {
+    uint32_t id;
+    int secondsOfDay;
+};
+
+// Parse "HH:MM", "HH:MM:SS", optionally preceded by "YYYY-MM-DD" and 'T' or
+// a space, into seconds since midnight. Returns -1 if malformed or if the
+// date is not the session date.
+int parseTapTime(string_view text, const string& sessionDate) {
+    if(text.size() >= 11 && (text[10] == 'T' || text[10] == ' ')) {
+        if(text.substr(0, 10) != sessionDate) return -1;
+        text.remove_prefix(11);
+    }
+    if((text.size() != 5 && text.size() != 8) || text[2] != ':' || (text.size() == 8 && text[5] != ':')) return -1;
+    int parts[3] = { 0, 0, 0 };
+    for(size_t i = 0, part = 0; i < text.size(); i += 3, part++) {
+        if(!isdigit(static_cast<unsigned char>(text[i])) || !isdigit(static_cast<unsigned char>(text[i + 1]))) return -1;
+        parts[part] = (text[i] - '0') * 10 + (text[i + 1] - '0');
+    }
+    if(parts[0] > 23 || parts[1] > 59 || parts[2] > 59) return -1;
+    return parts[0] * 3600 + parts[1] * 60 + parts[2];
+}
+
+// Live check-in: tap-in lines "INDEX TIME" (or "INDEX,TIME") arrive on stdin
+// or a named FIFO. A reader thread parses them and pushes them through a
+// lock-free SPSC queue to a marker thread, which marks PRESENT up to
+// startTime + grace and LATE after that. When the session window
+// (startTime + duration) closes, or the input ends, everyone without a
+// tap-in is marked ABSENT. Marks are group-committed to the journal.
+// The window closes at the first tap-in stamped at or after its end, or,
+// if it was still open when the command started, when the clock passes
+// its end with no input arriving; a log of a past session is read to the
+// end instead.
+int liveCheckInCommand(const string& sessionSpec, int graceMinutes, const string& fifoPath) {
+    AttendanceSession* session = findSessionBySpec(sessionSpec);
+    if(session == nullptr) {
+        return 1;
+    }
+    if(!touchSession(*session)) {
+        cout << "✗ Error: Could not read session " << session->getRecordName() << " from " << SESSION_DATA_FILE << endl;
+        return 1;
+    }
+    
+    int fd = fifoPath.empty() ? STDIN_FILENO : open(fifoPath.c_str(), O_RDONLY);
+    if(fd < 0) {
+        cout << "✗ Error: Could not open " << fifoPath << endl;
+        return 1;
+    }
+    
+    const int startSeconds = parseTapTime(session->getStartTime(), session->getDate());
+    const int graceEnd = startSeconds + graceMinutes * 60;
+    const int windowEnd = startSeconds + stoi(session->getDuration()) * 3600;
+    const string sessionDate = session->getDate();
+    
+    // Wall-clock end of the window, in local time
+    tm midnight = {};
+    midnight.tm_year = stoi(sessionDate.substr(0, 4)) - 1900;
+    midnight.tm_mon = stoi(sessionDate.substr(5, 2)) - 1;
+    midnight.tm_mday = stoi(sessionDate.substr(8, 2));
+    midnight.tm_isdst = -1;
+    const time_t deadline = mktime(&midnight) + windowEnd;
+    const bool closesOnClock = time(nullptr) < deadline;
+    auto pastDeadline = [&]() { return closesOnClock && time(nullptr) >= deadline; };
+    
+    vector<uint8_t> onRoster(students.idCount(), 0);
+    for(uint32_t id : session->getRosterIds()) {
+        onRoster[id] = 1;
+    }
+    
+    SpscQueue<TapEvent> queue(1 << 16);
+    atomic<bool> inputDone(false);
+    atomic<bool> windowClosed(false);
+    atomic<long long> eventsRead(0), rejectedEvents(0), presentMarks(0), lateMarks(0), ignoredEvents(0);
+    atomic<long long> unjournaledMarks(0);
+    
+    // Reader thread: parse lines and feed the queue. The registry is only
+    // read here, while the marker thread only changes the session.
+    thread reader([&]() {
+        vector<char> block(1 << 16);
+        string carry;
+        auto processLine = [&](string_view line) {
+            if(!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            size_t split = line.find_first_of(", \t");
+            if(split == string_view::npos) {
+                if(!line.empty()) rejectedEvents++;
+                return;
+            }
+            string_view index = line.substr(0, split);
+            string_view stamp = line.substr(line.find_first_not_of(", \t", split) == string_view::npos
+                                            ? line.size() : line.find_first_not_of(", \t", split));
+            int32_t id = students.findId(index);
+            int seconds = parseTapTime(stamp, sessionDate);
+            if(id == StudentRegistry::NO_ID || static_cast<size_t>(id) >= onRoster.size() || !onRoster[id] || seconds < 0) {
+                rejectedEvents++;
+                return;
+            }
+            eventsRead++;
+            TapEvent event = { static_cast<uint32_t>(id), seconds };
+            while(!queue.tryPush(event)) {
+                this_thread::yield();
+            }
+        };
+        ssize_t bytesRead = 1;
+        while(!windowClosed && bytesRead > 0) {
+            // Wait with a timeout so a closed window stops the reader
+            pollfd waitFor = { fd, POLLIN, 0 };
+            if(poll(&waitFor, 1, 100) <= 0) {
+                if(pastDeadline()) windowClosed = true;
+                continue;
+            }
+            bytesRead = read(fd, block.data(), block.size());
+            if(bytesRead <= 0) break;
+            string_view data(block.data(), static_cast<size_t>(bytesRead));
+            size_t pos = 0;
+            size_t newline;
+            while((newline = data.find('\n', pos)) != string_view::npos) {
+                if(!carry.empty()) {
+                    carry.append(data.substr(pos, newline - pos));
+                    processLine(carry);
+                    carry.clear();
+                } else {
+                    processLine(data.substr(pos, newline - pos));
+                }
+                pos = newline + 1;
+            }
+            carry.append(data.substr(pos));
+        }
+        if(!carry.empty()) processLine(carry);
+        inputDone = true;
+    });
+    
+    // Marker thread: classify taps and commit them in batches
+    thread marker([&]() {
+        vector<uint8_t> tapped(students.idCount(), 0);
+        vector<JournalEntry> batch;
+        vector<pair<uint32_t, AttendanceStatus>> pending;
+        auto lastCommit = chrono::steady_clock::now();
+        auto commit = [&]() {
+            if(batch.empty()) return;
+            STAT_SCOPE(TIMER_MARK);
+            lock_guard<mutex> lock(dataMutex);
+            bool journaled = journal.append(batch);
+            for(const auto& mark : pending) {
+                session->markAttendance(mark.first, mark.second);
+            }
+            if(!journaled) {
+                // No journal: save the session itself, as the background
+                // writer does; failing that, the final save retries it
+                bool saved = false;
+                saveDirtySessions(false, &saved);
+                if(!saved) unjournaledMarks += static_cast<long long>(batch.size());
+            }
+            batch.clear();
+            pending.clear();
+            lastCommit = chrono::steady_clock::now();
+        };
+        
+        TapEvent event = { 0, 0 };
+        while(true) {
+            if(!queue.tryPop(event)) {
+                if(inputDone) {
+                    // The reader has finished; drain what it pushed last
+                    if(!queue.tryPop(event)) break;
+                } else {
+                    if(chrono::steady_clock::now() - lastCommit > chrono::milliseconds(200)) commit();
+                    if(pastDeadline()) windowClosed = true; // the reader stops at its next poll
+                    this_thread::sleep_for(chrono::microseconds(200));
+                    continue;
+                }
+            }
+            if(event.secondsOfDay >= windowEnd) {
+                windowClosed = true;
+                ignoredEvents++;
+                continue;
+            }
+            if(tapped[event.id]) {
+                ignoredEvents++; // repeat tap; the first one counts
+                continue;
+            }
+            tapped[event.id] = 1;
+            AttendanceStatus status = event.secondsOfDay <= graceEnd ? PRESENT : LATE;
+            if(status == PRESENT) presentMarks++; else lateMarks++;
+            batch.push_back({session->getKey(), students[event.id].getIndexNumber(), status, static_cast<long long>(time(nullptr))});
+            pending.push_back({event.id, status});
+            if(batch.size() >= 4096) commit();
+        }
+        
+        // Window closed or input ended: everyone else is absent
+        for(uint32_t id : session->getRosterIds()) {
+            if(!tapped[id]) {
+                tapped[id] = 1;
+                batch.push_back({session->getKey(), students[id].getIndexNumber(), ABSENT, static_cast<long long>(time(nullptr))});
+                pending.push_back({id, ABSENT});
+            }
+        }
+        commit();
+    });
+    
+    // The console only reports progress; the pipeline never waits on it
+    auto start = chrono::steady_clock::now();
+    cout << "Live check-in for " << session->getRecordName() << " (grace " << graceMinutes
+         << " min, window closes at " << setw(2) << setfill('0') << windowEnd / 3600 % 24 << ":"
+         << setw(2) << windowEnd / 60 % 60 << setfill(' ') << ")\n";
+    marker.join();
+    reader.join();
+    if(!fifoPath.empty()) close(fd);
+    
+    bool saved = false;
+    {
+        lock_guard<mutex> lock(dataMutex);
+        saveDirtySessions(false, &saved);
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    
+    int p, a, l;
+    session->getSummary(p, a, l);
+    cout << "✓ Processed " << eventsRead << " tap-ins in " << fixed << setprecision(1) << seconds * 1000 << " ms ("
+         << setprecision(0) << (seconds > 0 ? eventsRead / seconds : 0) << " events/s); "
+         << rejectedEvents << " rejected, " << ignoredEvents << " repeat or after close.\n";
+    cout << "Present: " << p << " | Absent: " << a << " | Late: " << l << endl;
+    if(!saved) {
+        cout << "✗ Error: Could not save the session";
+        if(unjournaledMarks > 0) cout << "; " << unjournaledMarks << " mark(s) are not in the journal either";
+        cout << ".\n";
+        return 1;
+    }
+    return 0;
+}
@@ -7,6 +7,11 @@
 #include <string>
 #include <vector>
 #include <iomanip>
+#include <cstdint>
+#include <string_view>
+#include "text_parse.h"
+#include "durable_write.h"
+#include "hash_index.h"
 using namespace std;
 
 // Student Class Definition
@@ -47,17 +52,16 @@ public:
         return indexNumber + "," + name + "," + department + "," + to_string(level);
     }
 
-    // Create student from string
-    static Student fromString(string data) {
-        stringstream ss(data);
-        string idx, name, dept, lvlStr;
-        
-        getline(ss, idx, ',');
-        getline(ss, name, ',');
-        getline(ss, dept, ',');
-        getline(ss, lvlStr, ',');
-        
-        return Student(idx, name, dept, stoi(lvlStr));
+    // Create student from an "index,name,department,level" line;
+    // returns false if the line is malformed
+    static bool fromString(string_view data, Student& student) {
+        string_view fields[4];
+        int lvl;
+        if (splitFields(data, ',', fields, 4) != 4 || !parseNumber(fields[3], lvl)) {
+            return false;
+        }
+        student = Student(string(fields[0]), string(fields[1]), string(fields[2]), lvl);
+        return true;
     }
 };
 
@@ -65,6 +69,26 @@ public:
 class StudentManagementSystem {
 private:
     vector<Student> students;
+    vector<int32_t> indexSlots; // open-addressing hash index (hash_index.h): -1 = empty, else position in students
+
+    // Returns the slot holding indexNumber, or the empty slot where it belongs
+    size_t probeSlot(const string& indexNumber) {
+        return probeIndexSlot(indexSlots, indexNumber, false, [&](int32_t position) { return students[position].getIndexNumber(); });
+    }
+
+    // Add students[position] to the index, growing the table to keep it at most half full
+    void indexStudent(int position) {
+        size_t capacity = indexCapacityFor(students.size() + 1, indexSlots.size());
+        if (capacity != indexSlots.size()) {
+            indexSlots.assign(capacity, -1);
+            for (int i = 0; i < position; i++) {
+                size_t slot = probeSlot(students[i].getIndexNumber());
+                if (indexSlots[slot] == -1) indexSlots[slot] = i;
+            }
+        }
+        size_t slot = probeSlot(students[position].getIndexNumber());
+        if (indexSlots[slot] == -1) indexSlots[slot] = position;
+    }
 
 public:
     // Constructor - Load existing students
@@ -105,6 +129,7 @@ public:
         cin >> level;
 
         students.push_back(Student(indexNumber, name, department, level));
+        indexStudent(students.size() - 1);
         saveStudents();
         
         cout << "\nSUCCESS: Student registered successfully!\n";
@@ -178,40 +203,52 @@ public:
 
     // Find student helper function
     Student* findStudent(string indexNumber) {
-        for (int i = 0; i < students.size(); i++) {
-            if (students[i].getIndexNumber() == indexNumber) {
-                return &students[i];
-            }
+        if (indexSlots.empty()) {
+            return nullptr;
         }
-        return nullptr;
+        int position = indexSlots[probeSlot(indexNumber)];
+        return position == -1 ? nullptr : &students[position];
     }
 
-    // Save students to file
+    // Save students to file. The list is written to a temporary file and
+    // renamed over students.txt, so a crash never leaves it half written.
     void saveStudents() {
-        ofstream file("students.txt");
-        if (file.is_open()) {
-            for (int i = 0; i < students.size(); i++) {
-                file << students[i].toString() << endl;
-            }
-            file.close();
+        string buffer;
+        for (int i = 0; i < students.size(); i++) {
+            buffer += students[i].toString();
+            buffer += '\n';
+        }
+        GroupCommit commit;
+        commit.replace("students.txt", move(buffer));
+        if (commit.commit()) {
             cout << "\nData saved to students.txt\n";
         } else {
-            cout << "\nERROR: Could not save to file!\n";
+            cout << "\nERROR: Could not save to file! (" << commit.error() << ")\n";
         }
     }
 
     // Load students from file
     void loadStudents() {
-        ifstream file("students.txt");
-        if (file.is_open()) {
-            string line;
-            while (getline(file, line)) {
-                if (!line.empty()) {
-                    students.push_back(Student::fromString(line));
+        string text;
+        if (readWholeFile("students.txt", text)) {
+            vector<ParseError> errors;
+            LineReader reader(text);
+            string_view line;
+            while (reader.next(line)) {
+                if (line.empty()) continue;
+                Student student;
+                if (!Student::fromString(line, student)) {
+                    errors.push_back({reader.lineNumber(), "expected index,name,department,level"});
+                    continue;
                 }
+                students.push_back(student);
+                indexStudent(students.size() - 1);
             }
-            file.close();
             cout << "Loaded " << students.size() << " students from file.\n";
+            if (!errors.empty()) {
+                cout << "Skipped " << errors.size() << " malformed line(s):\n";
+                reportParseErrors(cout, "students.txt", errors);
+            }
         }
     }
 
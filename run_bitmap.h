@@ -0,0 +1,162 @@
+// Run-length compressed bitmaps shared by the attendance programs.
+// A set of bit positions is kept as sorted, non-touching runs of set
+// bits, so a long stretch of ones costs one run instead of a bit per
+// position. Setting bits in increasing order, the usual case, appends to
+// or extends the last run; intersections and unions walk both run lists
+// once.
+
+#ifndef RUN_BITMAP_H
+#define RUN_BITMAP_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+
+class RunBitmap {
+public:
+    struct Run {
+        uint32_t start;
+        uint32_t length;
+        uint32_t end() const { return start + length; }
+    };
+
+private:
+    std::vector<Run> runs; // sorted; a gap of at least one bit between runs
+
+    // First run starting after bit
+    std::vector<Run>::iterator after(uint32_t bit) {
+        return std::upper_bound(runs.begin(), runs.end(), bit,
+                                [](uint32_t b, const Run& run) { return b < run.start; });
+    }
+
+    std::vector<Run>::const_iterator after(uint32_t bit) const {
+        return std::upper_bound(runs.begin(), runs.end(), bit,
+                                [](uint32_t b, const Run& run) { return b < run.start; });
+    }
+
+    // Append [start, end) to a bitmap being built in order
+    void appendRange(uint32_t start, uint32_t end) {
+        if(start >= end) return;
+        if(!runs.empty() && runs.back().end() >= start) {
+            runs.back().length = std::max(runs.back().end(), end) - runs.back().start;
+        } else {
+            runs.push_back({start, end - start});
+        }
+    }
+
+public:
+    bool empty() const { return runs.empty(); }
+    const std::vector<Run>& getRuns() const { return runs; }
+    size_t runCount() const { return runs.size(); }
+
+    // Heap bytes held by the runs
+    size_t memoryBytes() const { return runs.capacity() * sizeof(Run); }
+    void shrink() { runs.shrink_to_fit(); }
+
+    bool test(uint32_t bit) const {
+        auto next = after(bit);
+        if(next == runs.begin()) return false;
+        --next;
+        return bit < next->end();
+    }
+
+    // Number of set bits
+    uint32_t count() const {
+        uint32_t total = 0;
+        for(const Run& run : runs) total += run.length;
+        return total;
+    }
+
+    void set(uint32_t bit) {
+        if(runs.empty() || bit > runs.back().end()) {
+            runs.push_back({bit, 1});
+            return;
+        }
+        auto next = after(bit);
+        if(next != runs.begin()) {
+            auto previous = next - 1;
+            if(bit < previous->end()) return;
+            if(bit == previous->end()) {
+                previous->length++;
+                // The bit may close the gap to the next run
+                if(next != runs.end() && next->start == bit + 1) {
+                    previous->length += next->length;
+                    runs.erase(next);
+                }
+                return;
+            }
+        }
+        if(next != runs.end() && next->start == bit + 1) {
+            next->start--;
+            next->length++;
+            return;
+        }
+        runs.insert(next, {bit, 1});
+    }
+
+    void clear(uint32_t bit) {
+        auto next = after(bit);
+        if(next == runs.begin()) return;
+        auto run = next - 1;
+        if(bit >= run->end()) return;
+        uint32_t end = run->end();
+        if(run->length == 1) {
+            runs.erase(run);
+        } else if(bit == run->start) {
+            run->start++;
+            run->length--;
+        } else if(bit == end - 1) {
+            run->length--;
+        } else {
+            run->length = bit - run->start;
+            runs.insert(run + 1, {bit + 1, end - bit - 1});
+        }
+    }
+
+    static RunBitmap intersect(const RunBitmap& a, const RunBitmap& b) {
+        RunBitmap result;
+        size_t i = 0;
+        size_t j = 0;
+        while(i < a.runs.size() && j < b.runs.size()) {
+            const Run& x = a.runs[i];
+            const Run& y = b.runs[j];
+            result.appendRange(std::max(x.start, y.start), std::min(x.end(), y.end()));
+            if(x.end() < y.end()) i++;
+            else j++;
+        }
+        return result;
+    }
+
+    static RunBitmap unite(const RunBitmap& a, const RunBitmap& b) {
+        RunBitmap result;
+        size_t i = 0;
+        size_t j = 0;
+        while(i < a.runs.size() || j < b.runs.size()) {
+            bool takeA = j == b.runs.size() || (i < a.runs.size() && a.runs[i].start <= b.runs[j].start);
+            const Run& run = takeA ? a.runs[i++] : b.runs[j++];
+            result.appendRange(run.start, run.end());
+        }
+        return result;
+    }
+
+    // Longest number of hits with no break between them; the bitmaps are
+    // disjoint, and positions in neither (e.g. columns out of scope) do
+    // not interrupt a streak
+    static uint32_t longestUnbroken(const RunBitmap& hits, const RunBitmap& breaks) {
+        uint32_t longest = 0;
+        uint32_t current = 0;
+        size_t j = 0;
+        for(const Run& run : hits.runs) {
+            while(j < breaks.runs.size() && breaks.runs[j].start < run.start) {
+                current = 0;
+                j++;
+            }
+            current += run.length;
+            longest = std::max(longest, current);
+        }
+        return longest;
+    }
+};
+
+#endif
@@ -0,0 +1,107 @@
+// Text parsing shared by the attendance programs.
+// A file is read into one buffer and split into lines and fields as
+// string_views pointing into it, so no string is allocated per line or
+// per field. Numbers are converted with from_chars; problems are
+// returned with the line number instead of thrown.
+
+#ifndef TEXT_PARSE_H
+#define TEXT_PARSE_H
+
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <cctype>
+#include <fstream>
+#include <ostream>
+#include <vector>
+
+// Read a whole file into buffer; false if it cannot be opened or read
+inline bool readWholeFile(const std::string& filename, std::string& buffer) {
+    std::ifstream file(filename, std::ios::binary);
+    if(!file.is_open()) return false;
+    file.seekg(0, std::ios::end);
+    std::streamoff size = file.tellg();
+    if(size < 0) return false;
+    buffer.resize(static_cast<size_t>(size));
+    file.seekg(0, std::ios::beg);
+    file.read(&buffer[0], size);
+    return static_cast<std::streamoff>(file.gcount()) == size;
+}
+
+// Walks the lines of a buffer. Line numbers start at 1, a trailing '\r'
+// is dropped and offset() is the number of bytes consumed so far,
+// including the newline of the last line returned.
+class LineReader {
+private:
+    std::string_view text;
+    size_t position = 0;
+    size_t number = 0;
+
+public:
+    explicit LineReader(std::string_view buffer) : text(buffer) {}
+
+    bool next(std::string_view& line) {
+        if(position >= text.size()) return false;
+        size_t newline = text.find('\n', position);
+        size_t end = newline == std::string_view::npos ? text.size() : newline;
+        line = text.substr(position, end - position);
+        if(!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        position = newline == std::string_view::npos ? text.size() : newline + 1;
+        number++;
+        return true;
+    }
+
+    size_t lineNumber() const { return number; }
+    size_t offset() const { return position; }
+
+    // True when the last line returned ended with a newline
+    bool lineTerminated() const { return position > 0 && text[position - 1] == '\n'; }
+};
+
+// Split line at each delimiter into at most maxFields views; returns
+// the number of fields found, which is maxFields + 1 if there are more
+inline size_t splitFields(std::string_view line, char delimiter, std::string_view* fields, size_t maxFields) {
+    size_t count = 0;
+    size_t start = 0;
+    while(true) {
+        size_t end = line.find(delimiter, start);
+        if(count == maxFields) return maxFields + 1;
+        fields[count++] = line.substr(start, end == std::string_view::npos ? std::string_view::npos : end - start);
+        if(end == std::string_view::npos) return count;
+        start = end + 1;
+    }
+}
+
+inline std::string_view trimField(std::string_view field) {
+    while(!field.empty() && isspace(static_cast<unsigned char>(field.front()))) field.remove_prefix(1);
+    while(!field.empty() && isspace(static_cast<unsigned char>(field.back()))) field.remove_suffix(1);
+    return field;
+}
+
+// Parse the whole field (surrounding spaces allowed) as an integer
+template<typename T>
+bool parseNumber(std::string_view field, T& value) {
+    field = trimField(field);
+    if(field.empty()) return false;
+    const char* end = field.data() + field.size();
+    auto result = std::from_chars(field.data(), end, value);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+// A malformed line and what was wrong with it
+struct ParseError {
+    size_t line;
+    std::string message;
+};
+
+inline void reportParseErrors(std::ostream& out, const std::string& filename, const std::vector<ParseError>& errors,
+                              size_t limit = 10) {
+    for(size_t i = 0; i < errors.size() && i < limit; i++) {
+        out << "  " << filename << ":" << errors[i].line << ": " << errors[i].message << "\n";
+    }
+    if(errors.size() > limit) {
+        out << "  ... and " << errors.size() - limit << " more\n";
+    }
+}
+
+#endif